@@ -0,0 +1,392 @@
+/* end-to-end benchmark: key command strings fed to irmpc on stdin,
+ * time until mock mpd has answered the mpd command they result in */
+#include "mockmpd.h"
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* no answer within this time counts as timeout */
+#define IRMPC_BENCH_TIMEOUT_US 5000000
+/* no mpd traffic for this long: irmpc is done with a key */
+#define IRMPC_BENCH_QUIET_US   30000
+/* startup incl. reading whole queue */
+#define IRMPC_BENCH_START_US   60000000
+/* playlist numbers used for p: keys - three digits load without waiting */
+#define IRMPC_BENCH_PLAYLIST_BASE 100
+
+/* one line of script: <label> <mpd command acknowledging keys> <keys ...> */
+static const char *irmpc_bench_default_script =
+    "play         play      m:play\n"
+    "pause        pause     m:pause\n"
+    "next         next      m:next\n"
+    "prev         previous  m:prev\n"
+    "nextalbum    play      m:nextalbum\n"
+    "prevalbum    play      m:prevalbum\n"
+    "albumskip    play      m:albumskip:3\n"
+    "delete       delete    m:delete\n"
+    "repeat       repeat    m:togglerepeat\n"
+    "random       random    m:togglerandom\n"
+    "single       single    m:togglesingle\n"
+    "volume       setvol    v:up\n"
+    "mute         setvol    v:mute\n"
+    "playlist     load      p:1 p:2 p:3\n"
+    "nextplaylist load      m:nextplaylist\n"
+    "stop         stop      m:stop\n";
+
+static struct irmpc_mockmpd_config bench_mpd = {
+    .port            = 0,
+    .queue_length    = 100000,
+    .album_length    = 10,
+    .playlists       = 100,
+    .playlist_length = 1000,
+    .latency_us      = 0,
+    .delays          = NULL
+};
+
+static const char *bench_irmpc      = "./irmpc";
+static const char *bench_script     = NULL;
+static int         bench_iterations = 100;
+static int         bench_skipwindow = 0;
+static int         bench_partitions = 0;
+static gboolean    bench_serve      = false;
+static gboolean    bench_verbose    = false;
+
+static GOptionEntry bench_entries [] = {
+    {"irmpc",          'i', 0, G_OPTION_ARG_FILENAME,     &bench_irmpc,                   "irmpc executable - default: ./irmpc",                       "path"},
+    {"script",         's', 0, G_OPTION_ARG_FILENAME,     &bench_script,                  "Cases to run: <label> <mpd command> <keys ...> per line",   "filename"},
+    {"iterations",     'n', 0, G_OPTION_ARG_INT,          &bench_iterations,              "Key presses per case - default: 100",                       "n"},
+    {"queue",          'q', 0, G_OPTION_ARG_INT,          &bench_mpd.queue_length,        "Songs in queue - default: 100000",                          "n"},
+    {"album",          'a', 0, G_OPTION_ARG_INT,          &bench_mpd.album_length,        "Songs per album - default: 10",                             "n"},
+    {"playlists",      0,   0, G_OPTION_ARG_INT,          &bench_mpd.playlists,           "Stored playlists - default: 100",                           "n"},
+    {"playlistlength", 0,   0, G_OPTION_ARG_INT,          &bench_mpd.playlist_length,     "Songs per stored playlist - default: 1000",                 "n"},
+    {"latency",        'l', 0, G_OPTION_ARG_INT,          &bench_mpd.latency_us,          "Delay in us before each mpd response - default: 0",         "us"},
+    {"delay",          'D', 0, G_OPTION_ARG_STRING_ARRAY, &bench_mpd.delays,              "Extra delay for one mpd command, repeatable",               "command=us"},
+    {"skipwindow",     0,   0, G_OPTION_ARG_INT,          &bench_skipwindow,              "irmpc skipwindow in ms - default: 0",                       "ms"},
+    {"partitions",     0,   0, G_OPTION_ARG_INT,          &bench_partitions,              "irmpc partitions - default: 0",                             "n"},
+    {"serve",          0,   0, G_OPTION_ARG_NONE,         &bench_serve,                   "Only run mock mpd (on --port) until interrupted",           NULL},
+    {"port",           'P', 0, G_OPTION_ARG_INT,          &bench_mpd.port,                "Port of mock mpd - default: any free one",                  "port"},
+    {"verbose",        'v', 0, G_OPTION_ARG_NONE,         &bench_verbose,                 "Show mpd commands and irmpc output",                         NULL},
+    {NULL}
+};
+
+/* mpd traffic seen - updated from mock client threads */
+static GMutex       bench_mutex;
+static GCond        bench_cond;
+static const char  *bench_expect      = NULL;
+static gint64       bench_acked       = 0;
+static unsigned int bench_round_trips = 0;
+static gint64       bench_last        = 0;
+
+static void irmpc_bench_answered (const char *commands, gint64 time, gpointer data)
+{
+    if (bench_verbose) {
+        printf ("mpd: %s\n", commands);
+    }
+
+    g_mutex_lock (&bench_mutex);
+
+    /* idle answers are notifications - not caused by a request */
+    if (strcmp (commands, "idle") != 0) {
+        bench_round_trips++;
+
+        if ((bench_expect != NULL) && (bench_acked == 0)) {
+            gchar **names = g_strsplit (commands, " ", 0);
+            for (int i = 0; names[i] != NULL; i++) {
+                if (strcmp (names[i], bench_expect) == 0) {
+                    bench_acked = time;
+                    g_cond_broadcast (&bench_cond);
+                    break;
+                }
+            }
+            g_strfreev (names);
+        }
+    }
+
+    bench_last = time;
+
+    g_mutex_unlock (&bench_mutex);
+}
+
+/* wait until no request is open and nothing was answered for quiet_us */
+static bool irmpc_bench_settle (gint64 quiet_us, gint64 timeout_us)
+{
+    gint64 deadline = g_get_monotonic_time () + timeout_us;
+
+    while (g_get_monotonic_time () < deadline) {
+        g_mutex_lock (&bench_mutex);
+        gint64 last = bench_last;
+        g_mutex_unlock (&bench_mutex);
+
+        if ((irmpc_mockmpd_busy () == 0) && (g_get_monotonic_time () - last >= quiet_us)) return true;
+
+        g_usleep (1000);
+    }
+
+    return false;
+}
+
+/* config for irmpc: mock mpd, stdin input, numbered playlists */
+static gchar * irmpc_bench_config ()
+{
+    GString *config = g_string_new (NULL);
+
+    g_string_append_printf (config, "[mpd]\nhostname=127.0.0.1\nport=%u\nkeepalive=0\npartitions=%d\n\n", irmpc_mockmpd_port (), bench_partitions);
+    g_string_append_printf (config, "[lirc]\ninput=stdin\nskipwindow=%d\n\n", bench_skipwindow);
+    g_string_append (config, "[playlists]\n");
+    for (unsigned int i = 0; i < bench_mpd.playlists; i++) {
+        g_string_append_printf (config, "%u=Playlist %03u\n", IRMPC_BENCH_PLAYLIST_BASE + i, i);
+    }
+
+    gchar  *path  = NULL;
+    GError *error = NULL;
+    int     fd    = g_file_open_tmp ("irmpc-bench-XXXXXX.cfg", &path, &error);
+
+    if (fd == -1) {
+        fprintf (stderr, "ERROR: failed to create config file: %s\n", error->message);
+        g_error_free (error);
+        g_string_free (config, true);
+        return NULL;
+    }
+    close (fd);
+
+    if (!g_file_set_contents (path, config->str, config->len, &error)) {
+        fprintf (stderr, "ERROR: failed to write config file: %s\n", error->message);
+        g_error_free (error);
+        g_free (path);
+        path = NULL;
+    }
+
+    g_string_free (config, true);
+
+    return path;
+}
+
+/* start irmpc with stdin connected to returned fd */
+static int irmpc_bench_spawn (const char *config, GPid *pid)
+{
+    gchar  *argv [] = {(gchar *) bench_irmpc, "-c", (gchar *) config, (bench_verbose ? "-v" : NULL), NULL};
+    GError *error   = NULL;
+    int     input   = -1;
+    GSpawnFlags flags = G_SPAWN_DO_NOT_REAP_CHILD | (bench_verbose ? 0 : (G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL));
+
+    if (!g_spawn_async_with_pipes (NULL, argv, NULL, flags, NULL, NULL, pid, &input, NULL, NULL, &error)) {
+        fprintf (stderr, "ERROR: failed to start %s: %s\n", bench_irmpc, error->message);
+        g_error_free (error);
+        return -1;
+    }
+
+    return input;
+}
+
+static int irmpc_bench_cmp (gconstpointer a, gconstpointer b)
+{
+    gint64 da = *((const gint64 *) a);
+    gint64 db = *((const gint64 *) b);
+
+    return (da > db) - (da < db);
+}
+
+/* press keys of case repeatedly - one line of results */
+static bool irmpc_bench_case (int input, const char *label, const char *expect, const char *keys)
+{
+    GArray       *latencies   = g_array_new (false, false, sizeof (gint64));
+    unsigned int  round_trips = 0;
+    unsigned int  timeouts    = 0;
+    gchar        *line        = g_strconcat (keys, "\n", NULL);
+    bool          success     = true;
+
+    /* same start for each case: middle of generated queue */
+    irmpc_mockmpd_reset ();
+    irmpc_bench_settle (IRMPC_BENCH_QUIET_US, IRMPC_BENCH_START_US);
+
+    for (int i = 0; i < bench_iterations; i++) {
+        irmpc_bench_settle (IRMPC_BENCH_QUIET_US, IRMPC_BENCH_TIMEOUT_US);
+
+        g_mutex_lock (&bench_mutex);
+        bench_expect      = expect;
+        bench_acked       = 0;
+        bench_round_trips = 0;
+        g_mutex_unlock (&bench_mutex);
+
+        gint64 start = g_get_monotonic_time ();
+
+        if (write (input, line, strlen (line)) != (ssize_t) strlen (line)) {
+            fprintf (stderr, "ERROR: irmpc not reading input: %s\n", strerror (errno));
+            success = false;
+            break;
+        }
+
+        g_mutex_lock (&bench_mutex);
+        gint64 deadline = start + IRMPC_BENCH_TIMEOUT_US;
+        while (bench_acked == 0) {
+            if (!g_cond_wait_until (&bench_cond, &bench_mutex, deadline)) break;
+        }
+        gint64 acked = bench_acked;
+        g_mutex_unlock (&bench_mutex);
+
+        if (acked == 0) {
+            timeouts++;
+        } else {
+            gint64 latency = acked - start;
+            g_array_append_val (latencies, latency);
+        }
+
+        /* status refreshes etc. following the key are counted for it too */
+        irmpc_bench_settle (IRMPC_BENCH_QUIET_US, IRMPC_BENCH_TIMEOUT_US);
+
+        g_mutex_lock (&bench_mutex);
+        round_trips  += bench_round_trips;
+        bench_expect  = NULL;
+        g_mutex_unlock (&bench_mutex);
+    }
+
+    g_array_sort (latencies, irmpc_bench_cmp);
+
+    unsigned int n = latencies->len;
+    if (n > 0) {
+        printf ("%-14s %6u %10lld %10lld %10lld %8.2f %8u\n", label, n,
+                (long long) g_array_index (latencies, gint64, (n - 1) * 50 / 100),
+                (long long) g_array_index (latencies, gint64, (n - 1) * 99 / 100),
+                (long long) g_array_index (latencies, gint64, n - 1),
+                (double) round_trips / bench_iterations, timeouts);
+    } else {
+        printf ("%-14s %6u %10s %10s %10s %8.2f %8u\n", label, n, "-", "-", "-", (double) round_trips / MAX (bench_iterations, 1), timeouts);
+    }
+    fflush (stdout);
+
+    g_array_free (latencies, true);
+    g_free (line);
+
+    return success;
+}
+
+/* run all cases of script */
+static bool irmpc_bench_run (int input)
+{
+    gchar  *script = NULL;
+    GError *error  = NULL;
+
+    if (bench_script == NULL) {
+        script = g_strdup (irmpc_bench_default_script);
+    } else if (!g_file_get_contents (bench_script, &script, NULL, &error)) {
+        fprintf (stderr, "ERROR: failed to read script: %s\n", error->message);
+        g_error_free (error);
+        return false;
+    }
+
+    printf ("queue: %u songs, album: %u songs, mpd latency: %u us, iterations: %d\n",
+            bench_mpd.queue_length, bench_mpd.album_length, bench_mpd.latency_us, bench_iterations);
+    printf ("%-14s %6s %10s %10s %10s %8s %8s\n", "case", "n", "p50 us", "p99 us", "max us", "rt/key", "timeout");
+
+    gchar **lines   = g_strsplit (script, "\n", 0);
+    bool    success = true;
+
+    for (int i = 0; success && (lines[i] != NULL); i++) {
+        gchar *line = g_strstrip (lines[i]);
+        if ((line[0] == '\0') || (line[0] == '#')) continue;
+
+        gchar **fields = g_strsplit_set (line, " \t", 3);
+        for (int f = 0; fields[f] != NULL; f++) g_strstrip (fields[f]);
+
+        if ((g_strv_length (fields) < 3) || (fields[2][0] == '\0')) {
+            fprintf (stderr, "WARNING: ignoring script line \"%s\"\n", line);
+        } else {
+            success = irmpc_bench_case (input, fields[0], fields[1], fields[2]);
+        }
+
+        g_strfreev (fields);
+    }
+
+    g_strfreev (lines);
+    g_free (script);
+
+    return success;
+}
+
+static gboolean irmpc_bench_quit (gpointer data)
+{
+    g_main_loop_quit ((GMainLoop *) data);
+    return G_SOURCE_CONTINUE;
+}
+
+int main (int argc, char **argv)
+{
+    GError         *error   = NULL;
+    GOptionContext *context = g_option_context_new ("- key to mpd command latency of irmpc against mock mpd");
+
+    g_option_context_add_main_entries (context, bench_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        fprintf (stderr, "Error parsing options: %s\n", error->message);
+        g_error_free (error);
+        g_option_context_free (context);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    signal (SIGPIPE, SIG_IGN);
+
+    if (!irmpc_mockmpd_start (&bench_mpd, irmpc_bench_answered, NULL)) return 1;
+
+    if (bench_serve) {
+        GMainLoop *loop = g_main_loop_new (NULL, false);
+
+        printf ("mock mpd listening on 127.0.0.1:%u\n", irmpc_mockmpd_port ());
+        fflush (stdout);
+
+        g_unix_signal_add (SIGINT,  irmpc_bench_quit, loop);
+        g_unix_signal_add (SIGTERM, irmpc_bench_quit, loop);
+        g_main_loop_run (loop);
+        g_main_loop_unref (loop);
+
+        irmpc_mockmpd_stop ();
+        return 0;
+    }
+
+    gchar *config = irmpc_bench_config ();
+    if (config == NULL) {
+        irmpc_mockmpd_stop ();
+        return 1;
+    }
+
+    GPid pid;
+    int  input   = irmpc_bench_spawn (config, &pid);
+    bool success = false;
+
+    if (input != -1) {
+        /* sync + pipelined connection, initial status + queue read */
+        gint64 deadline = g_get_monotonic_time () + IRMPC_BENCH_START_US;
+        while ((irmpc_mockmpd_clients () < 2) && (g_get_monotonic_time () < deadline)) {
+            g_usleep (10000);
+        }
+
+        if (irmpc_mockmpd_clients () < 2) {
+            fprintf (stderr, "ERROR: irmpc did not connect to mock mpd\n");
+        } else if (!irmpc_bench_settle (IRMPC_BENCH_QUIET_US * 10, IRMPC_BENCH_START_US)) {
+            fprintf (stderr, "ERROR: irmpc did not finish startup\n");
+        } else {
+            success = irmpc_bench_run (input);
+        }
+
+        /* end of input ends irmpc */
+        close (input);
+        kill (pid, SIGTERM);
+        waitpid (pid, NULL, 0);
+        g_spawn_close_pid (pid);
+    }
+
+    unlink (config);
+    g_free (config);
+
+    irmpc_mockmpd_stop ();
+
+    return (success ? 0 : 1);
+}
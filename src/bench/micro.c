@@ -0,0 +1,351 @@
+/* microbenchmarks of in-process hot paths: command string dispatch,
+ * playlist lookups and config parsing for growing playlist tables */
+#include "command.h"
+#include "phash.h"
+#include "playlist.h"
+#include "options.h"
+
+#include <glib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* lookup arguments cycled through - power of 2 */
+#define IRMPC_BENCH_ARGS 1024
+
+/* allocations counted by overriding malloc for the whole process (glib included) */
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t count, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint64 bench_allocs = 0;
+
+void *malloc (size_t size)
+{
+    bench_allocs++;
+    return __libc_malloc (size);
+}
+
+void *calloc (size_t count, size_t size)
+{
+    bench_allocs++;
+    return __libc_calloc (count, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+    bench_allocs++;
+    return __libc_realloc (ptr, size);
+}
+
+/* results written here - keeps calls from being optimized away */
+static const void * volatile bench_sink;
+
+static int          bench_min_ms = 200;
+static const char  *bench_filter = NULL;
+static const char  *bench_sizes  = "10,1000,100000";
+
+static GOptionEntry bench_entries [] = {
+    {"time",   't', 0, G_OPTION_ARG_INT,    &bench_min_ms, "Minimum run time per benchmark in ms - default: 200",  "ms"},
+    {"filter", 'f', 0, G_OPTION_ARG_STRING, &bench_filter, "Only run benchmarks with names containing string",     "string"},
+    {"sizes",  's', 0, G_OPTION_ARG_STRING, &bench_sizes,  "Playlist table sizes - default: 10,1000,100000",        "n,n,..."},
+    {NULL}
+};
+
+/* state of current size */
+static unsigned int  bench_size                        = 0;
+static unsigned int  bench_numbers [IRMPC_BENCH_ARGS];
+static const char   *bench_names   [IRMPC_BENCH_ARGS];
+static char          bench_digits  [IRMPC_BENCH_ARGS] [16];
+static gchar        *bench_config                      = NULL;
+/* distinct config strings as in lirc config - dispatched by string hash */
+static gchar       **bench_strings                     = NULL;
+static struct irmpc_phash bench_dispatch_hash          = {0};
+
+static const char *bench_command_strings [] = {
+    "m:next", "m:prev", "m:playpause", "v:up", "v:down", "p:1", "p:7",
+    "m:nextalbum", "m:albumskip:3", "m:togglerandom", "s:room:kitchen", "s:poweroff"
+};
+#define IRMPC_BENCH_COMMAND_STRINGS (sizeof (bench_command_strings) / sizeof (bench_command_strings[0]))
+
+static gint64 irmpc_bench_now_ns ()
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t irmpc_bench_random (uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+/* benchmarks: run operation iterations times */
+static void irmpc_bench_command_compile (guint64 iterations)
+{
+    struct irmpc_command command;
+
+    for (guint64 i = 0; i < iterations; i++) {
+        irmpc_command_compile (bench_command_strings[i % IRMPC_BENCH_COMMAND_STRINGS], &command);
+        bench_sink = &command;
+    }
+}
+
+static void irmpc_bench_dispatch_lookup (guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        const char *string = bench_strings[bench_numbers[i & (IRMPC_BENCH_ARGS - 1)] % bench_size];
+        int         index  = irmpc_phash_lookup (&bench_dispatch_hash, irmpc_phash_string (string));
+
+        /* hit is confirmed by comparing strings, as in irhandler */
+        bench_sink = ((index >= 0) && (strcmp (bench_strings[index], string) == 0)) ? bench_strings[index] : NULL;
+    }
+}
+
+static void irmpc_bench_playlist_get (guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        bench_sink = irmpc_playlist_get (bench_numbers[i & (IRMPC_BENCH_ARGS - 1)]);
+    }
+}
+
+static void irmpc_bench_playlist_nextprev (guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        bench_sink = irmpc_playlist_nextprev (((i & 1) ? 1 : -1), bench_names[i & (IRMPC_BENCH_ARGS - 1)]);
+    }
+}
+
+static void irmpc_bench_playlist_match (guint64 iterations)
+{
+    const struct playlist_info *playlist;
+
+    for (guint64 i = 0; i < iterations; i++) {
+        bench_sink = (const void *) (intptr_t) irmpc_playlist_match (bench_digits[i & (IRMPC_BENCH_ARGS - 1)], &playlist);
+    }
+}
+
+static void irmpc_bench_playlist_table (guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        struct irmpc_playlist_table *table = irmpc_playlist_table_new ();
+        char                         name [32];
+
+        for (unsigned int number = 1; number <= bench_size; number++) {
+            snprintf (name, sizeof (name), "Playlist %06u", number);
+            irmpc_playlist_table_add (table, number, name, false);
+        }
+
+        /* index is built on first lookup */
+        irmpc_playlist_table_set (table);
+        bench_sink = irmpc_playlist_get (1);
+    }
+}
+
+static void irmpc_bench_options_parse (guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        struct irmpc_playlist_table *table   = NULL;
+        struct _irmpc_options       *options = irmpc_options_reload (&table);
+
+        if (options == NULL) {
+            fprintf (stderr, "ERROR: parsing benchmark config failed\n");
+            exit (1);
+        }
+        bench_sink = table;
+        irmpc_playlist_table_free (table);
+        irmpc_options_unref (options);
+    }
+}
+
+struct irmpc_bench {
+    const char *name;
+    bool        sized;
+    void      (*run) (guint64 iterations);
+};
+
+static const struct irmpc_bench irmpc_benches [] = {
+    {"command_compile",   false, irmpc_bench_command_compile},
+    {"dispatch_lookup",   true,  irmpc_bench_dispatch_lookup},
+    {"playlist_get",      true,  irmpc_bench_playlist_get},
+    {"playlist_nextprev", true,  irmpc_bench_playlist_nextprev},
+    {"playlist_match",    true,  irmpc_bench_playlist_match},
+    {"playlist_table",    true,  irmpc_bench_playlist_table},
+    {"options_parse",     true,  irmpc_bench_options_parse},
+    {NULL}
+};
+
+/* run with growing iteration count until minimum time is reached */
+static void irmpc_bench_measure (const struct irmpc_bench *bench)
+{
+    guint64 iterations = 1;
+    gint64  elapsed    = 0;
+    guint64 allocs     = 0;
+
+    /* warm up: lazily built indexes etc. */
+    bench->run (1);
+
+    while (true) {
+        guint64 allocs_start = bench_allocs;
+        gint64  start        = irmpc_bench_now_ns ();
+
+        bench->run (iterations);
+
+        elapsed = irmpc_bench_now_ns () - start;
+        allocs  = bench_allocs - allocs_start;
+
+        if (elapsed >= (gint64) bench_min_ms * 1000000) break;
+
+        /* aim at minimum time with some margin */
+        guint64 next = (elapsed > 0) ? (iterations * bench_min_ms * 1200000 / elapsed) : (iterations * 100);
+        iterations   = CLAMP (next, iterations * 2, iterations * 100);
+    }
+
+    char size [16] = "-";
+    if (bench->sized) snprintf (size, sizeof (size), "%u", bench_size);
+
+    printf ("%-20s %8s %12llu %14.1f %12.2f\n", bench->name, size, (unsigned long long) iterations,
+            (double) elapsed / iterations, (double) allocs / iterations);
+    fflush (stdout);
+}
+
+/* playlists 1..size as table + config file, lookup arguments, dispatch table of size config strings */
+static bool irmpc_bench_setup (unsigned int size)
+{
+    uint32_t state = 2463534242u;
+
+    bench_size = size;
+
+    struct irmpc_playlist_table *table  = irmpc_playlist_table_new ();
+    GString                     *config = g_string_new ("[playlists]\n");
+    char                         name [32];
+
+    for (unsigned int number = 1; number <= size; number++) {
+        snprintf (name, sizeof (name), "Playlist %06u", number);
+        irmpc_playlist_table_add (table, number, name, (number % 3 == 0));
+        g_string_append_printf (config, "%u=%s%s\n", number, name, ((number % 3 == 0) ? ";r" : ""));
+    }
+
+    /* config file is read like on startup - options are only set by parsing */
+    GError *error   = NULL;
+    bool    success = true;
+    int     fd      = g_file_open_tmp ("irmpc-bench-XXXXXX.cfg", &bench_config, &error);
+
+    if (fd == -1) {
+        fprintf (stderr, "ERROR: failed to create config file: %s\n", error->message);
+        g_error_free (error);
+        success = false;
+    } else {
+        close (fd);
+        if (!g_file_set_contents (bench_config, config->str, config->len, &error)) {
+            fprintf (stderr, "ERROR: failed to write config file: %s\n", error->message);
+            g_error_free (error);
+            success = false;
+        } else {
+            char  *args [] = {"micro", "--config", bench_config, NULL};
+            char **argv    = args;
+            int    argc    = 3;
+
+            success = irmpc_parse_options (&argc, &argv);
+        }
+    }
+
+    g_string_free (config, true);
+
+    /* replaces table parsed from config file */
+    irmpc_playlist_table_set (table);
+
+    for (unsigned int i = 0; i < IRMPC_BENCH_ARGS; i++) {
+        bench_numbers[i] = 1 + irmpc_bench_random (&state) % size;
+        bench_names[i]   = irmpc_playlist_get (bench_numbers[i])->name;
+        snprintf (bench_digits[i], sizeof (bench_digits[i]), "%u", bench_numbers[i]);
+    }
+
+    /* dispatch table keys: hashes of distinct config strings */
+    uint64_t *keys = g_new (uint64_t, size);
+    bench_strings  = g_new0 (gchar *, size + 1);
+    for (unsigned int i = 0; i < size; i++) {
+        bench_strings[i] = (i < IRMPC_BENCH_COMMAND_STRINGS) ? g_strdup (bench_command_strings[i]) : g_strdup_printf ("m:albumskip:%u", i);
+        keys[i]          = irmpc_phash_string (bench_strings[i]);
+    }
+    bool built = irmpc_phash_build (&bench_dispatch_hash, keys, size);
+    g_free (keys);
+
+    if (!built) {
+        success = false;
+        fprintf (stderr, "ERROR: failed to build dispatch table of %u strings\n", size);
+    }
+
+    return success;
+}
+
+static void irmpc_bench_teardown ()
+{
+    irmpc_playlist_free ();
+    irmpc_phash_free (&bench_dispatch_hash);
+    g_strfreev (bench_strings);
+    bench_strings = NULL;
+
+    if (bench_config != NULL) {
+        unlink (bench_config);
+        g_free (bench_config);
+        bench_config = NULL;
+    }
+}
+
+static bool irmpc_bench_selected (const struct irmpc_bench *bench)
+{
+    return (bench_filter == NULL) || (strstr (bench->name, bench_filter) != NULL);
+}
+
+int main (int argc, char **argv)
+{
+    GError         *error   = NULL;
+    GOptionContext *context = g_option_context_new ("- microbenchmarks of irmpc hot paths");
+
+    g_option_context_add_main_entries (context, bench_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        fprintf (stderr, "Error parsing options: %s\n", error->message);
+        g_error_free (error);
+        g_option_context_free (context);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    printf ("%-20s %8s %12s %14s %12s\n", "benchmark", "size", "iterations", "ns/op", "allocs/op");
+
+    for (const struct irmpc_bench *bench = &(irmpc_benches[0]); bench->name != NULL; bench++) {
+        if ((!bench->sized) && irmpc_bench_selected (bench)) irmpc_bench_measure (bench);
+    }
+
+    gchar **sizes   = g_strsplit (bench_sizes, ",", 0);
+    int     result  = 0;
+
+    for (int s = 0; (result == 0) && (sizes[s] != NULL); s++) {
+        unsigned int size = strtoul (sizes[s], NULL, 10);
+        if (size == 0) continue;
+
+        if (!irmpc_bench_setup (size)) {
+            result = 1;
+        } else {
+            for (const struct irmpc_bench *bench = &(irmpc_benches[0]); bench->name != NULL; bench++) {
+                if (bench->sized && irmpc_bench_selected (bench)) irmpc_bench_measure (bench);
+            }
+        }
+
+        irmpc_bench_teardown ();
+    }
+
+    g_strfreev (sizes);
+    irmpc_command_free ();
+
+    return result;
+}
@@ -0,0 +1,767 @@
+#include "mockmpd.h"
+
+#include <glib.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* protocol version reported - partitions need 0.22 */
+#define IRMPC_MOCKMPD_GREETING "OK MPD 0.23.5\n"
+
+/* idle subsystems - in order of names below */
+enum irmpc_mockmpd_event {
+    IRMPC_MOCKMPD_PLAYLIST  = 1 << 0,
+    IRMPC_MOCKMPD_PLAYER    = 1 << 1,
+    IRMPC_MOCKMPD_MIXER     = 1 << 2,
+    IRMPC_MOCKMPD_OPTIONS   = 1 << 3,
+    IRMPC_MOCKMPD_STORED    = 1 << 4,
+    IRMPC_MOCKMPD_PARTITION = 1 << 5,
+    IRMPC_MOCKMPD_OUTPUT    = 1 << 6
+};
+
+static const char *irmpc_mockmpd_event_names [] = {
+    "playlist", "player", "mixer", "options", "stored_playlist", "partition", "output", NULL
+};
+
+enum irmpc_mockmpd_state {
+    IRMPC_MOCKMPD_STOP,
+    IRMPC_MOCKMPD_PLAY,
+    IRMPC_MOCKMPD_PAUSE
+};
+
+/* queue entry - tags are generated from id + album */
+struct irmpc_mockmpd_song {
+    guint id;
+    guint album;
+};
+
+/* queue version + first position changed by it - for plchanges */
+struct irmpc_mockmpd_change {
+    guint version;
+    guint position;
+};
+
+struct irmpc_mockmpd_client {
+    int       fd;
+    /* woken on idle events */
+    int       event_fd;
+    GThread  *thread;
+    GString  *in;
+    gchar    *partition;
+    /* idle events not yet reported */
+    guint     events;
+};
+
+/* everything below protected by mock_mutex - commands run one at a time */
+static GMutex                       mock_mutex;
+static struct irmpc_mockmpd_config  mock_config;
+static GHashTable                  *mock_delays     = NULL;
+static GArray                      *mock_queue      = NULL;
+static GArray                      *mock_changes    = NULL;
+static bool                         mock_generated  = false;
+static guint                        mock_version    = 0;
+static guint                        mock_next_id    = 0;
+static guint                        mock_next_album = 0;
+static enum irmpc_mockmpd_state     mock_state      = IRMPC_MOCKMPD_STOP;
+static guint                        mock_song       = 0;
+static int                          mock_volume     = 50;
+static bool                         mock_repeat     = false;
+static bool                         mock_random     = false;
+static bool                         mock_single     = false;
+static GList                       *mock_clients    = NULL;
+
+static irmpc_mockmpd_callback       mock_callback      = NULL;
+static gpointer                     mock_callback_data = NULL;
+static int                          mock_listen_fd     = -1;
+static unsigned int                 mock_port          = 0;
+static GThread                     *mock_accept_thread = NULL;
+static gint                         mock_stopping      = 0;
+static gint                         mock_client_count  = 0;
+static gint                         mock_busy          = 0;
+
+/* split command line into arguments - quoted ones with backslash escapes */
+static gchar ** irmpc_mockmpd_split (const char *line)
+{
+    GPtrArray  *args = g_ptr_array_new ();
+    const char *p    = line;
+
+    while (true) {
+        while ((*p == ' ') || (*p == '\t')) p++;
+        if (*p == '\0') break;
+
+        GString *arg = g_string_new (NULL);
+
+        if (*p == '"') {
+            for (p++; (*p != '\0') && (*p != '"'); p++) {
+                if ((*p == '\\') && (p[1] != '\0')) p++;
+                g_string_append_c (arg, *p);
+            }
+            if (*p == '"') p++;
+        } else {
+            for (; (*p != '\0') && (*p != ' ') && (*p != '\t'); p++) {
+                g_string_append_c (arg, *p);
+            }
+        }
+
+        g_ptr_array_add (args, g_string_free (arg, false));
+    }
+
+    g_ptr_array_add (args, NULL);
+
+    return (gchar **) g_ptr_array_free (args, false);
+}
+
+/* position or start:end range limited to queue */
+static void irmpc_mockmpd_range (const char *arg, guint *start, guint *end)
+{
+    *start = 0;
+    *end   = mock_queue->len;
+
+    if (arg == NULL) return;
+
+    char *endptr;
+    *start = strtoul (arg, &endptr, 10);
+    if (*endptr == ':') {
+        if (endptr[1] != '\0') *end = strtoul (endptr + 1, NULL, 10);
+    } else {
+        *end = *start + 1;
+    }
+
+    if (*end > mock_queue->len) *end = mock_queue->len;
+    if (*start > *end) *start = *end;
+}
+
+static void irmpc_mockmpd_queue_changed (guint position)
+{
+    mock_version++;
+
+    struct irmpc_mockmpd_change change = {mock_version, position};
+    g_array_append_val (mock_changes, change);
+}
+
+/* first position changed after version - G_MAXUINT if none */
+static guint irmpc_mockmpd_changed_from (guint version)
+{
+    guint from = G_MAXUINT;
+
+    for (guint i = mock_changes->len; i > 0; i--) {
+        struct irmpc_mockmpd_change *change = &g_array_index (mock_changes, struct irmpc_mockmpd_change, i - 1);
+        if (change->version <= version) break;
+        if (change->position < from) from = change->position;
+    }
+
+    return from;
+}
+
+/* append generated songs - albums start with first song added */
+static void irmpc_mockmpd_queue_add (guint count)
+{
+    guint album_length = MAX (mock_config.album_length, 1);
+    guint position     = mock_queue->len;
+
+    for (guint i = 0; i < count; i++) {
+        struct irmpc_mockmpd_song song = {
+            .id    = mock_next_id++,
+            .album = mock_next_album + i / album_length
+        };
+        g_array_append_val (mock_queue, song);
+    }
+
+    mock_next_album += (count + album_length - 1) / album_length;
+    irmpc_mockmpd_queue_changed (position);
+}
+
+static void irmpc_mockmpd_song (GString *out, guint position)
+{
+    struct irmpc_mockmpd_song *song = &g_array_index (mock_queue, struct irmpc_mockmpd_song, position);
+
+    g_string_append_printf (out, "file: mock/album%u/%u.flac\nTitle: Track %u\nAlbum: Album %u\nPos: %u\nId: %u\n",
+                            song->album, song->id, song->id, song->album, position, song->id);
+}
+
+static void irmpc_mockmpd_status (struct irmpc_mockmpd_client *client, GString *out)
+{
+    static const char *states [] = {"stop", "play", "pause"};
+
+    g_string_append_printf (out, "volume: %d\nrepeat: %d\nrandom: %d\nsingle: %d\nconsume: 0\npartition: %s\nplaylist: %u\nplaylistlength: %u\nstate: %s\n",
+                            mock_volume, mock_repeat, mock_random, mock_single, client->partition, mock_version, mock_queue->len, states[mock_state]);
+
+    if (mock_state != IRMPC_MOCKMPD_STOP) {
+        g_string_append_printf (out, "song: %u\nsongid: %u\n", mock_song, g_array_index (mock_queue, struct irmpc_mockmpd_song, mock_song).id);
+    }
+}
+
+/* report idle events to all clients */
+static void irmpc_mockmpd_notify (guint events)
+{
+    if (events == 0) return;
+
+    for (GList *item = mock_clients; item != NULL; item = item->next) {
+        struct irmpc_mockmpd_client *client = item->data;
+        uint64_t                     one    = 1;
+
+        client->events |= events;
+        if (write (client->event_fd, &one, sizeof (one)) < 0) {
+            /* counter full - client is woken anyway */
+        }
+    }
+}
+
+/* run one command - returns mpd error code (0: success) + message */
+static int irmpc_mockmpd_execute (struct irmpc_mockmpd_client *client, gchar **argv, GString *out, guint *events, const char **message)
+{
+    const char *cmd  = argv[0];
+    const char *arg  = argv[1];
+    guint       len  = mock_queue->len;
+
+    if ((strcmp (cmd, "ping") == 0) || (strcmp (cmd, "password") == 0)) {
+        return 0;
+    } else if (strcmp (cmd, "status") == 0) {
+        irmpc_mockmpd_status (client, out);
+    } else if (strcmp (cmd, "currentsong") == 0) {
+        if (mock_state != IRMPC_MOCKMPD_STOP) irmpc_mockmpd_song (out, mock_song);
+    } else if (strcmp (cmd, "playlistinfo") == 0) {
+        guint start, end;
+        irmpc_mockmpd_range (arg, &start, &end);
+        for (guint pos = start; pos < end; pos++) irmpc_mockmpd_song (out, pos);
+    } else if ((strcmp (cmd, "plchanges") == 0) || (strcmp (cmd, "plchangesposid") == 0)) {
+        guint start, end;
+        guint from = irmpc_mockmpd_changed_from ((arg != NULL) ? strtoul (arg, NULL, 10) : 0);
+
+        irmpc_mockmpd_range ((arg != NULL) ? argv[2] : NULL, &start, &end);
+        for (guint pos = MAX (start, from); pos < end; pos++) {
+            if (cmd[9] == '\0') {
+                irmpc_mockmpd_song (out, pos);
+            } else {
+                g_string_append_printf (out, "cpos: %u\nId: %u\n", pos, g_array_index (mock_queue, struct irmpc_mockmpd_song, pos).id);
+            }
+        }
+    } else if (strcmp (cmd, "listplaylists") == 0) {
+        for (guint i = 0; i < mock_config.playlists; i++) {
+            g_string_append_printf (out, "playlist: Playlist %03u\nLast-Modified: 2024-01-01T00:00:00Z\n", i);
+        }
+    } else if (strcmp (cmd, "outputs") == 0) {
+        g_string_append (out, "outputid: 0\noutputname: Mock output\nplugin: null\noutputenabled: 1\n");
+    } else if (strcmp (cmd, "listpartitions") == 0) {
+        g_string_append (out, "partition: default\n");
+    } else if (strcmp (cmd, "partition") == 0) {
+        if (arg == NULL) goto error_args;
+        g_free (client->partition);
+        client->partition = g_strdup (arg);
+    } else if ((strcmp (cmd, "newpartition") == 0) || (strcmp (cmd, "delpartition") == 0)) {
+        *events |= IRMPC_MOCKMPD_PARTITION;
+    } else if (strcmp (cmd, "moveoutput") == 0) {
+        *events |= IRMPC_MOCKMPD_OUTPUT;
+    } else if (strcmp (cmd, "play") == 0) {
+        guint pos = (arg != NULL) ? strtoul (arg, NULL, 10) : ((mock_state == IRMPC_MOCKMPD_STOP) ? 0 : mock_song);
+        if (pos >= len) {
+            *message = "Bad song index";
+            return 2;
+        }
+        mock_state = IRMPC_MOCKMPD_PLAY;
+        mock_song  = pos;
+        *events   |= IRMPC_MOCKMPD_PLAYER;
+    } else if (strcmp (cmd, "pause") == 0) {
+        if (mock_state == IRMPC_MOCKMPD_STOP) return 0;
+        bool pause = (arg != NULL) ? (strcmp (arg, "1") == 0) : (mock_state == IRMPC_MOCKMPD_PLAY);
+        mock_state = pause ? IRMPC_MOCKMPD_PAUSE : IRMPC_MOCKMPD_PLAY;
+        *events   |= IRMPC_MOCKMPD_PLAYER;
+    } else if (strcmp (cmd, "stop") == 0) {
+        mock_state = IRMPC_MOCKMPD_STOP;
+        *events   |= IRMPC_MOCKMPD_PLAYER;
+    } else if ((strcmp (cmd, "next") == 0) || (strcmp (cmd, "previous") == 0)) {
+        if (mock_state == IRMPC_MOCKMPD_STOP) return 0;
+        if (cmd[0] == 'n') {
+            if (mock_song + 1 < len) {
+                mock_song++;
+            } else if (mock_repeat) {
+                mock_song = 0;
+            } else {
+                mock_state = IRMPC_MOCKMPD_STOP;
+            }
+        } else if (mock_song > 0) {
+            mock_song--;
+        }
+        *events |= IRMPC_MOCKMPD_PLAYER;
+    } else if (strcmp (cmd, "delete") == 0) {
+        guint pos = (arg != NULL) ? strtoul (arg, NULL, 10) : len;
+        if (pos >= len) {
+            *message = "Bad song index";
+            return 2;
+        }
+        g_array_remove_index (mock_queue, pos);
+        if (pos < mock_song) {
+            mock_song--;
+        } else if ((pos == mock_song) && (mock_song >= mock_queue->len)) {
+            mock_state = IRMPC_MOCKMPD_STOP;
+            mock_song  = 0;
+        }
+        mock_generated = false;
+        irmpc_mockmpd_queue_changed (pos);
+        *events |= IRMPC_MOCKMPD_PLAYLIST | IRMPC_MOCKMPD_PLAYER;
+    } else if (strcmp (cmd, "clear") == 0) {
+        g_array_set_size (mock_queue, 0);
+        mock_state     = IRMPC_MOCKMPD_STOP;
+        mock_song      = 0;
+        mock_generated = false;
+        irmpc_mockmpd_queue_changed (0);
+        *events |= IRMPC_MOCKMPD_PLAYLIST | IRMPC_MOCKMPD_PLAYER;
+    } else if (strcmp (cmd, "load") == 0) {
+        if (arg == NULL) goto error_args;
+        irmpc_mockmpd_queue_add (mock_config.playlist_length);
+        mock_generated = false;
+        *events |= IRMPC_MOCKMPD_PLAYLIST;
+    } else if ((strcmp (cmd, "save") == 0) || (strcmp (cmd, "rm") == 0)) {
+        if (arg == NULL) goto error_args;
+        *events |= IRMPC_MOCKMPD_STORED;
+    } else if (strcmp (cmd, "setvol") == 0) {
+        if (arg == NULL) goto error_args;
+        mock_volume = CLAMP (atoi (arg), 0, 100);
+        *events    |= IRMPC_MOCKMPD_MIXER;
+    } else if ((strcmp (cmd, "repeat") == 0) || (strcmp (cmd, "random") == 0) || (strcmp (cmd, "single") == 0) || (strcmp (cmd, "consume") == 0)) {
+        if (arg == NULL) goto error_args;
+        bool set = (strcmp (arg, "1") == 0);
+        if (strcmp (cmd, "repeat") == 0) mock_repeat = set;
+        if (strcmp (cmd, "random") == 0) mock_random = set;
+        if (strcmp (cmd, "single") == 0) mock_single = set;
+        *events |= IRMPC_MOCKMPD_OPTIONS;
+    } else {
+        *message = "unknown command";
+        return 5;
+    }
+
+    return 0;
+
+error_args:
+    *message = "wrong number of arguments";
+    return 2;
+}
+
+static bool irmpc_mockmpd_write (struct irmpc_mockmpd_client *client, const char *data, gsize len)
+{
+    while (len > 0) {
+        ssize_t written = send (client->fd, data, len, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        len  -= written;
+    }
+    return true;
+}
+
+/* run command (list) and answer it after configured delays */
+static bool irmpc_mockmpd_request (struct irmpc_mockmpd_client *client, GPtrArray *lines, bool list, bool list_ok)
+{
+    GString *out    = g_string_new (NULL);
+    GString *names  = g_string_new (NULL);
+    guint    events = 0;
+    gint64   delay  = mock_config.latency_us;
+    bool     failed = false;
+
+    g_mutex_lock (&mock_mutex);
+
+    for (guint i = 0; i < lines->len; i++) {
+        gchar      **argv    = irmpc_mockmpd_split (g_ptr_array_index (lines, i));
+        const char  *message = NULL;
+        int          error   = 0;
+
+        if (argv[0] == NULL) {
+            g_strfreev (argv);
+            continue;
+        }
+
+        g_string_append_printf (names, "%s%s", ((names->len > 0) ? " " : ""), argv[0]);
+
+        gpointer command_delay;
+        if ((mock_delays != NULL) && g_hash_table_lookup_extended (mock_delays, argv[0], NULL, &command_delay)) {
+            delay += GPOINTER_TO_INT (command_delay);
+        }
+
+        error = irmpc_mockmpd_execute (client, argv, out, &events, &message);
+
+        if (error != 0) {
+            g_string_append_printf (out, "ACK [%d@%u] {%s} %s\n", error, (list ? i : 0), argv[0], message);
+            g_strfreev (argv);
+            failed = true;
+            break;
+        }
+
+        if (list_ok) g_string_append (out, "list_OK\n");
+        g_strfreev (argv);
+    }
+
+    if (!failed) g_string_append (out, "OK\n");
+
+    irmpc_mockmpd_notify (events);
+
+    g_mutex_unlock (&mock_mutex);
+
+    if (delay > 0) g_usleep (delay);
+
+    bool success = irmpc_mockmpd_write (client, out->str, out->len);
+
+    g_atomic_int_add (&mock_busy, -1);
+
+    if (success && (mock_callback != NULL)) {
+        mock_callback (names->str, g_get_monotonic_time (), mock_callback_data);
+    }
+
+    g_string_free (out,   true);
+    g_string_free (names, true);
+
+    return success;
+}
+
+/* read more input - false on end of connection */
+static bool irmpc_mockmpd_fill (struct irmpc_mockmpd_client *client)
+{
+    char    buffer [4096];
+    ssize_t len;
+
+    do {
+        len = read (client->fd, buffer, sizeof (buffer));
+    } while ((len < 0) && (errno == EINTR));
+
+    if (len <= 0) return false;
+
+    g_string_append_len (client->in, buffer, len);
+    return true;
+}
+
+/* next complete line without newline - NULL on end of connection */
+static gchar * irmpc_mockmpd_line (struct irmpc_mockmpd_client *client)
+{
+    gchar *newline;
+
+    while ((newline = memchr (client->in->str, '\n', client->in->len)) == NULL) {
+        if (!irmpc_mockmpd_fill (client)) return NULL;
+    }
+
+    gsize  len  = newline - client->in->str;
+    gchar *line = g_strndup (client->in->str, len);
+    g_string_erase (client->in, 0, len + 1);
+
+    return line;
+}
+
+/* wait for events of subsystems or noidle */
+static bool irmpc_mockmpd_idle (struct irmpc_mockmpd_client *client, gchar **argv)
+{
+    guint mask = 0;
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        for (int e = 0; irmpc_mockmpd_event_names[e] != NULL; e++) {
+            if (strcmp (argv[i], irmpc_mockmpd_event_names[e]) == 0) mask |= 1 << e;
+        }
+    }
+    if (argv[1] == NULL) mask = G_MAXUINT;
+
+    guint events = 0;
+    bool  alive  = true;
+
+    while (true) {
+        /* command already received ends idle */
+        bool ended = (memchr (client->in->str, '\n', client->in->len) != NULL);
+
+        g_mutex_lock (&mock_mutex);
+        events          = client->events & mask;
+        client->events &= ~events;
+        g_mutex_unlock (&mock_mutex);
+
+        if (ended || (events != 0)) break;
+
+        struct pollfd fds [2] = {
+            {.fd = client->fd,       .events = POLLIN},
+            {.fd = client->event_fd, .events = POLLIN}
+        };
+
+        if (poll (fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            alive = false;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read (client->event_fd, &count, sizeof (count)) < 0) {
+                /* woken anyway */
+            }
+        }
+
+        if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && (!irmpc_mockmpd_fill (client))) {
+            alive = false;
+            break;
+        }
+    }
+
+    if (!alive) return false;
+
+    /* noidle itself gets no further response */
+    if (g_str_has_prefix (client->in->str, "noidle\n")) {
+        g_string_erase (client->in, 0, strlen ("noidle\n"));
+    }
+
+    GString *out = g_string_new (NULL);
+    for (int e = 0; irmpc_mockmpd_event_names[e] != NULL; e++) {
+        if (events & (1 << e)) g_string_append_printf (out, "changed: %s\n", irmpc_mockmpd_event_names[e]);
+    }
+    g_string_append (out, "OK\n");
+
+    bool success = irmpc_mockmpd_write (client, out->str, out->len);
+    g_string_free (out, true);
+
+    if (success && (mock_callback != NULL)) {
+        mock_callback ("idle", g_get_monotonic_time (), mock_callback_data);
+    }
+
+    return success;
+}
+
+static gpointer irmpc_mockmpd_client_thread (gpointer data)
+{
+    struct irmpc_mockmpd_client *client  = data;
+    GPtrArray                   *lines   = g_ptr_array_new_with_free_func (g_free);
+    bool                         list    = false;
+    bool                         list_ok = false;
+    gchar                       *line;
+
+    if (!irmpc_mockmpd_write (client, IRMPC_MOCKMPD_GREETING, strlen (IRMPC_MOCKMPD_GREETING))) goto client_exit;
+
+    while ((line = irmpc_mockmpd_line (client)) != NULL) {
+        if (list) {
+            if (strcmp (line, "command_list_end") == 0) {
+                g_free (line);
+                list = false;
+                g_atomic_int_inc (&mock_busy);
+                if (!irmpc_mockmpd_request (client, lines, true, list_ok)) break;
+                g_ptr_array_set_size (lines, 0);
+            } else {
+                g_ptr_array_add (lines, line);
+            }
+            continue;
+        }
+
+        if ((strcmp (line, "command_list_begin") == 0) || (strcmp (line, "command_list_ok_begin") == 0)) {
+            list    = true;
+            list_ok = (line[13] == 'o');
+            g_free (line);
+            continue;
+        }
+
+        gchar **argv = irmpc_mockmpd_split (line);
+        bool    done = false;
+
+        if (argv[0] == NULL) {
+            /* empty line */
+        } else if (strcmp (argv[0], "idle") == 0) {
+            done = !irmpc_mockmpd_idle (client, argv);
+        } else if (strcmp (argv[0], "noidle") == 0) {
+            /* not idle - ignored like mpd does */
+        } else if (strcmp (argv[0], "close") == 0) {
+            done = true;
+        } else {
+            g_ptr_array_add (lines, g_strdup (line));
+            g_atomic_int_inc (&mock_busy);
+            done = !irmpc_mockmpd_request (client, lines, false, false);
+            g_ptr_array_set_size (lines, 0);
+        }
+
+        g_strfreev (argv);
+        g_free (line);
+
+        if (done) break;
+    }
+
+client_exit:
+    g_ptr_array_free (lines, true);
+    shutdown (client->fd, SHUT_RDWR);
+    g_atomic_int_add (&mock_client_count, -1);
+
+    return NULL;
+}
+
+static gpointer irmpc_mockmpd_accept_thread (gpointer data)
+{
+    while (!g_atomic_int_get (&mock_stopping)) {
+        int fd = accept (mock_listen_fd, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        int nodelay = 1;
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof (nodelay));
+
+        struct irmpc_mockmpd_client *client = g_new0 (struct irmpc_mockmpd_client, 1);
+
+        client->fd        = fd;
+        client->event_fd  = eventfd (0, EFD_CLOEXEC);
+        client->in        = g_string_new (NULL);
+        client->partition = g_strdup ("default");
+
+        g_mutex_lock (&mock_mutex);
+        mock_clients = g_list_prepend (mock_clients, client);
+        g_mutex_unlock (&mock_mutex);
+
+        g_atomic_int_inc (&mock_client_count);
+        client->thread = g_thread_new ("mockmpd-client", irmpc_mockmpd_client_thread, client);
+    }
+
+    return NULL;
+}
+
+/* back to generated queue, playing song in the middle, default options */
+void irmpc_mockmpd_reset ()
+{
+    guint events = IRMPC_MOCKMPD_PLAYER | IRMPC_MOCKMPD_OPTIONS | IRMPC_MOCKMPD_MIXER;
+
+    g_mutex_lock (&mock_mutex);
+
+    if (!mock_generated) {
+        g_array_set_size (mock_queue, 0);
+        mock_next_album = 0;
+        irmpc_mockmpd_queue_add (mock_config.queue_length);
+        mock_generated = true;
+        events |= IRMPC_MOCKMPD_PLAYLIST;
+    }
+
+    mock_state  = (mock_queue->len > 0) ? IRMPC_MOCKMPD_PLAY : IRMPC_MOCKMPD_STOP;
+    mock_song   = mock_queue->len / 2;
+    mock_volume = 50;
+    mock_repeat = false;
+    mock_random = false;
+    mock_single = false;
+
+    irmpc_mockmpd_notify (events);
+
+    g_mutex_unlock (&mock_mutex);
+}
+
+/* listen on localhost - port 0 picks a free one */
+bool irmpc_mockmpd_start (const struct irmpc_mockmpd_config *config, irmpc_mockmpd_callback callback, gpointer data)
+{
+    mock_config        = *config;
+    mock_callback      = callback;
+    mock_callback_data = data;
+    mock_queue         = g_array_new (false, false, sizeof (struct irmpc_mockmpd_song));
+    mock_changes       = g_array_new (false, false, sizeof (struct irmpc_mockmpd_change));
+
+    for (int i = 0; (config->delays != NULL) && (config->delays[i] != NULL); i++) {
+        gchar *value = strchr (config->delays[i], '=');
+        if (value == NULL) {
+            fprintf (stderr, "ERROR: delay needs form <command>=<us>: %s\n", config->delays[i]);
+            return false;
+        }
+
+        if (mock_delays == NULL) {
+            mock_delays = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        }
+        g_hash_table_insert (mock_delays, g_strndup (config->delays[i], value - config->delays[i]), GINT_TO_POINTER (atoi (value + 1)));
+    }
+
+    irmpc_mockmpd_reset ();
+
+    struct sockaddr_in address = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons (config->port),
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK)
+    };
+    socklen_t address_len = sizeof (address);
+    int       reuse       = 1;
+
+    mock_listen_fd = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mock_listen_fd == -1) {
+        fprintf (stderr, "ERROR: failed to create mock mpd socket: %s\n", strerror (errno));
+        return false;
+    }
+    setsockopt (mock_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+
+    if ((bind (mock_listen_fd, (struct sockaddr *) &address, sizeof (address)) != 0) || (listen (mock_listen_fd, 16) != 0) ||
+        (getsockname (mock_listen_fd, (struct sockaddr *) &address, &address_len) != 0)) {
+        fprintf (stderr, "ERROR: failed to listen for mock mpd connections: %s\n", strerror (errno));
+        close (mock_listen_fd);
+        mock_listen_fd = -1;
+        return false;
+    }
+
+    mock_port          = ntohs (address.sin_port);
+    mock_accept_thread = g_thread_new ("mockmpd-accept", irmpc_mockmpd_accept_thread, NULL);
+
+    return true;
+}
+
+unsigned int irmpc_mockmpd_port ()
+{
+    return mock_port;
+}
+
+/* connected clients */
+unsigned int irmpc_mockmpd_clients ()
+{
+    return g_atomic_int_get (&mock_client_count);
+}
+
+/* requests received but not answered yet - idle excluded */
+unsigned int irmpc_mockmpd_busy ()
+{
+    return g_atomic_int_get (&mock_busy);
+}
+
+void irmpc_mockmpd_stop ()
+{
+    if (mock_accept_thread != NULL) {
+        g_atomic_int_set (&mock_stopping, 1);
+        shutdown (mock_listen_fd, SHUT_RDWR);
+        g_thread_join (mock_accept_thread);
+        mock_accept_thread = NULL;
+    }
+
+    if (mock_listen_fd != -1) {
+        close (mock_listen_fd);
+        mock_listen_fd = -1;
+    }
+
+    /* wake client threads blocked on reading */
+    g_mutex_lock (&mock_mutex);
+    for (GList *item = mock_clients; item != NULL; item = item->next) {
+        struct irmpc_mockmpd_client *client = item->data;
+        shutdown (client->fd, SHUT_RDWR);
+    }
+    GList *clients = mock_clients;
+    mock_clients = NULL;
+    g_mutex_unlock (&mock_mutex);
+
+    for (GList *item = clients; item != NULL; item = item->next) {
+        struct irmpc_mockmpd_client *client = item->data;
+
+        g_thread_join (client->thread);
+        close (client->fd);
+        close (client->event_fd);
+        g_string_free (client->in, true);
+        g_free (client->partition);
+        g_free (client);
+    }
+    g_list_free (clients);
+
+    if (mock_delays != NULL) {
+        g_hash_table_destroy (mock_delays);
+        mock_delays = NULL;
+    }
+
+    if (mock_queue != NULL) {
+        g_array_free (mock_queue, true);
+        g_array_free (mock_changes, true);
+        mock_queue   = NULL;
+        mock_changes = NULL;
+    }
+}
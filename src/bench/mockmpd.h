@@ -0,0 +1,28 @@
+#ifndef __mockmpd_h__
+#define __mockmpd_h__
+
+#include <stdbool.h>
+#include <glib.h>
+
+/* generated server contents + response delays */
+struct irmpc_mockmpd_config {
+    unsigned int  port;             /* 0: any free port */
+    unsigned int  queue_length;     /* songs in queue at start + after reset */
+    unsigned int  album_length;     /* songs per album in generated queue */
+    unsigned int  playlists;        /* stored playlists */
+    unsigned int  playlist_length;  /* songs added by load */
+    unsigned int  latency_us;       /* delay before each response */
+    gchar       **delays;           /* per command delays: <command>=<us> */
+};
+
+/* called after a response was written - commands: names of command (list) separated by ' ' */
+typedef void (*irmpc_mockmpd_callback) (const char *commands, gint64 time, gpointer data);
+
+bool         irmpc_mockmpd_start   (const struct irmpc_mockmpd_config *config, irmpc_mockmpd_callback callback, gpointer data);
+unsigned int irmpc_mockmpd_port    ();
+unsigned int irmpc_mockmpd_clients ();
+unsigned int irmpc_mockmpd_busy    ();
+void         irmpc_mockmpd_reset   ();
+void         irmpc_mockmpd_stop    ();
+
+#endif
@@ -0,0 +1,142 @@
+#include "command.h"
+#include "phash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* config string keywords - commands taking a number or name end with ':' */
+struct irmpc_command_keyword {
+    const char              *name;
+    enum irmpc_command_type  type;
+    enum irmpc_opcode        op;
+};
+
+static const struct irmpc_command_keyword irmpc_command_keywords [] = {
+    {"m:playpause",      IRMPC_COMMAND_MPD,      IRMPC_OP_PLAYPAUSE},
+    {"m:play",           IRMPC_COMMAND_MPD,      IRMPC_OP_PLAY},
+    {"m:pause",          IRMPC_COMMAND_MPD,      IRMPC_OP_PAUSE},
+    {"m:next",           IRMPC_COMMAND_MPD,      IRMPC_OP_NEXT},
+    {"m:prev",           IRMPC_COMMAND_MPD,      IRMPC_OP_PREV},
+    {"m:stop",           IRMPC_COMMAND_MPD,      IRMPC_OP_STOP},
+    {"m:delete",         IRMPC_COMMAND_MPD,      IRMPC_OP_DELETE},
+    {"m:playlistupdate", IRMPC_COMMAND_MPD,      IRMPC_OP_PLAYLISTUPDATE},
+    {"m:nextplaylist",   IRMPC_COMMAND_MPD,      IRMPC_OP_NEXTPLAYLIST},
+    {"m:prevplaylist",   IRMPC_COMMAND_MPD,      IRMPC_OP_PREVPLAYLIST},
+    {"m:repeat",         IRMPC_COMMAND_MPD,      IRMPC_OP_REPEAT},
+    {"m:repeatoff",      IRMPC_COMMAND_MPD,      IRMPC_OP_REPEATOFF},
+    {"m:togglerepeat",   IRMPC_COMMAND_MPD,      IRMPC_OP_TOGGLEREPEAT},
+    {"m:single",         IRMPC_COMMAND_MPD,      IRMPC_OP_SINGLE},
+    {"m:singleoff",      IRMPC_COMMAND_MPD,      IRMPC_OP_SINGLEOFF},
+    {"m:togglesingle",   IRMPC_COMMAND_MPD,      IRMPC_OP_TOGGLESINGLE},
+    {"m:random",         IRMPC_COMMAND_MPD,      IRMPC_OP_RANDOM},
+    {"m:randomoff",      IRMPC_COMMAND_MPD,      IRMPC_OP_RANDOMOFF},
+    {"m:togglerandom",   IRMPC_COMMAND_MPD,      IRMPC_OP_TOGGLERANDOM},
+    {"m:nextalbum",      IRMPC_COMMAND_MPD,      IRMPC_OP_NEXTALBUM},
+    {"m:prevalbum",      IRMPC_COMMAND_MPD,      IRMPC_OP_PREVALBUM},
+    {"m:albumstart",     IRMPC_COMMAND_MPD,      IRMPC_OP_ALBUMSTART},
+    {"m:albumskip:",     IRMPC_COMMAND_MPD,      IRMPC_OP_ALBUMSKIP},
+    {"v:up",             IRMPC_COMMAND_VOLUME,   IRMPC_OP_VOLUME_UP},
+    {"v:down",           IRMPC_COMMAND_VOLUME,   IRMPC_OP_VOLUME_DOWN},
+    {"v:mute",           IRMPC_COMMAND_VOLUME,   IRMPC_OP_VOLUME_MUTE},
+    {"p:",               IRMPC_COMMAND_PLAYLIST, IRMPC_OP_PLAYLIST_KEY},
+    {"s:poweroff",       IRMPC_COMMAND_SYSTEM,   IRMPC_OP_POWEROFF},
+    {"s:room:",          IRMPC_COMMAND_SYSTEM,   IRMPC_OP_ROOM},
+    {NULL}
+};
+
+/* keyword lookup - built on first use */
+static struct irmpc_phash command_keyword_hash  = {0};
+static bool               command_keyword_built = false;
+
+static bool irmpc_command_keywords_build ()
+{
+    unsigned int count = 0;
+    while (irmpc_command_keywords[count].name != NULL) count++;
+
+    uint64_t keys [count];
+    for (unsigned int i = 0; i < count; i++) {
+        keys[i] = irmpc_phash_string (irmpc_command_keywords[i].name);
+    }
+
+    command_keyword_built = irmpc_phash_build (&command_keyword_hash, keys, count);
+
+    return command_keyword_built;
+}
+
+/* keyword entry of name - NULL if unknown */
+static const struct irmpc_command_keyword * irmpc_command_keyword (const char *name)
+{
+    if (!command_keyword_built && !irmpc_command_keywords_build ()) return NULL;
+
+    int index = irmpc_phash_lookup (&command_keyword_hash, irmpc_phash_string (name));
+    if (index < 0) return NULL;
+
+    const struct irmpc_command_keyword *keyword = &(irmpc_command_keywords[index]);
+    if (strcmp (keyword->name, name) != 0) return NULL;
+
+    return keyword;
+}
+
+bool irmpc_command_compile (const char *string, struct irmpc_command *command)
+{
+    size_t len = strlen (string);
+
+    if ((len < 3) || (string[1] != ':') || (len - 2 >= IRMPC_COMMAND_ARG_MAX)) return false;
+
+    memset (command, 0, sizeof (struct irmpc_command));
+    strcpy (command->arg, &(string[2]));
+
+    /* numeric argument after last ':' */
+    const char *last_colon = strrchr (string, ':');
+    char       *endptr     = NULL;
+    long int    number     = strtol (last_colon + 1, &endptr, 10);
+    bool        has_number = ((last_colon[1] != '\0') && (*endptr == '\0'));
+
+    /* keyword of commands taking an argument: up to last ':' */
+    char prefix [IRMPC_COMMAND_ARG_MAX + 2];
+    memcpy (prefix, string, last_colon - string + 1);
+    prefix[last_colon - string + 1] = '\0';
+
+    const struct irmpc_command_keyword *keyword;
+
+    if (has_number) {
+        keyword = irmpc_command_keyword (prefix);
+    } else {
+        keyword = irmpc_command_keyword (string);
+
+        /* name argument after last ':' */
+        if ((keyword == NULL) && (last_colon[1] != '\0')) {
+            keyword = irmpc_command_keyword (prefix);
+            if ((keyword != NULL) && (keyword->op != IRMPC_OP_ROOM)) return false;
+        }
+    }
+
+    if (keyword == NULL) return false;
+
+    /* keywords taking a number end with ':' */
+    bool takes_number = (keyword->name[strlen (keyword->name) - 1] == ':');
+    if ((takes_number != has_number) && (keyword->op != IRMPC_OP_ROOM)) return false;
+
+    switch (keyword->op) {
+        case IRMPC_OP_PLAYLIST_KEY:
+            if ((number < 0) || (number > 9) || (len != 3)) return false;
+            break;
+        case IRMPC_OP_ALBUMSKIP:
+            if (number == 0) return false;
+            break;
+        default:
+            break;
+    }
+
+    command->type   = keyword->type;
+    command->op     = keyword->op;
+    command->number = (has_number ? number : 0);
+
+    return true;
+}
+
+void irmpc_command_free ()
+{
+    irmpc_phash_free (&command_keyword_hash);
+    command_keyword_built = false;
+}
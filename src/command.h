@@ -0,0 +1,70 @@
+#ifndef __command_h__
+#define __command_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* command classes as prefixed in lircrc config strings */
+enum irmpc_command_type {
+    IRMPC_COMMAND_MPD,       /* m:<command> */
+    IRMPC_COMMAND_VOLUME,    /* v:<command> */
+    IRMPC_COMMAND_PLAYLIST,  /* p:<digit>   */
+    IRMPC_COMMAND_SYSTEM     /* s:<command> */
+};
+
+/* operations - one per config string keyword */
+enum irmpc_opcode {
+    IRMPC_OP_UNKNOWN,
+    /* m: */
+    IRMPC_OP_PLAYPAUSE,
+    IRMPC_OP_PLAY,
+    IRMPC_OP_PAUSE,
+    IRMPC_OP_NEXT,
+    IRMPC_OP_PREV,
+    IRMPC_OP_STOP,
+    IRMPC_OP_DELETE,
+    IRMPC_OP_PLAYLISTUPDATE,
+    IRMPC_OP_NEXTPLAYLIST,
+    IRMPC_OP_PREVPLAYLIST,
+    IRMPC_OP_REPEAT,
+    IRMPC_OP_REPEATOFF,
+    IRMPC_OP_TOGGLEREPEAT,
+    IRMPC_OP_SINGLE,
+    IRMPC_OP_SINGLEOFF,
+    IRMPC_OP_TOGGLESINGLE,
+    IRMPC_OP_RANDOM,
+    IRMPC_OP_RANDOMOFF,
+    IRMPC_OP_TOGGLERANDOM,
+    IRMPC_OP_NEXTALBUM,
+    IRMPC_OP_PREVALBUM,
+    IRMPC_OP_ALBUMSTART,
+    IRMPC_OP_ALBUMSKIP,      /* number: albums */
+    /* v: */
+    IRMPC_OP_VOLUME_UP,
+    IRMPC_OP_VOLUME_DOWN,
+    IRMPC_OP_VOLUME_MUTE,
+    /* p: */
+    IRMPC_OP_PLAYLIST_KEY,   /* number: digit */
+    /* s: */
+    IRMPC_OP_POWEROFF,
+    IRMPC_OP_ROOM,           /* arg: room:<names> */
+    IRMPC_OP_COUNT
+};
+
+#define IRMPC_COMMAND_ARG_MAX 32
+
+/* parsed command passed from input decoding to mpd execution */
+struct irmpc_command {
+    enum irmpc_command_type type;
+    enum irmpc_opcode       op;
+    int                     number;
+    unsigned int            repeat;  /* lirc repeat counter - 0: new press */
+    char                    arg [IRMPC_COMMAND_ARG_MAX];    /* config string without prefix - for messages */
+    int64_t                 time;    /* monotonic time in us when pushed */
+};
+
+/* parse config string like "m:next" - returns false if unknown or invalid */
+bool irmpc_command_compile (const char *string, struct irmpc_command *command);
+void irmpc_command_free    ();
+
+#endif
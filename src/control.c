@@ -0,0 +1,268 @@
+#include "control.h"
+#include "options.h"
+#include "command.h"
+#include "irhandler.h"
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* longest command line accepted */
+#define IRMPC_CONTROL_LINE_MAX 256
+/* replies not read by client - dropped beyond this */
+#define IRMPC_CONTROL_OUT_MAX  65536
+
+/* connected client: lines read so far + replies not yet written */
+struct irmpc_control_client {
+    int      fd;
+    guint    watch_id;
+    bool     writing;
+    GString *in;
+    GString *out;
+    /* rest of a too long line is skipped */
+    bool     discard;
+};
+
+/* listening socket - path kept as options may change on reload */
+static int    control_fd       = -1;
+static gchar *control_path     = NULL;
+static guint  control_watch_id = 0;
+static GList *control_clients  = NULL;
+
+static void irmpc_control_client_free (struct irmpc_control_client *client)
+{
+    if (client->watch_id != 0) {
+        g_source_remove (client->watch_id);
+    }
+
+    close (client->fd);
+    g_string_free (client->in,  true);
+    g_string_free (client->out, true);
+    g_free (client);
+}
+
+static void irmpc_control_client_close (struct irmpc_control_client *client)
+{
+    if (irmpc_options.debug) {
+        printf ("INFO: control client %d disconnected\n", client->fd);
+    }
+
+    control_clients = g_list_remove (control_clients, client);
+    irmpc_control_client_free (client);
+}
+
+/* run one command line - reply appended to output */
+static void irmpc_control_line (struct irmpc_control_client *client, const char *line)
+{
+    struct irmpc_command command;
+
+    if (irmpc_options.debug) {
+        printf ("INFO: control command: \"%s\"\n", line);
+    }
+
+    if (strcmp (line, "ping") == 0) {
+        g_string_append (client->out, "OK\n");
+    } else if (!irmpc_command_compile (line, &command)) {
+        g_string_append_printf (client->out, "ACK unknown command \"%s\"\n", line);
+    } else if (!irmpc_irhandler_command (&command)) {
+        g_string_append (client->out, "ACK command dropped\n");
+    } else {
+        g_string_append (client->out, "OK\n");
+    }
+}
+
+/* run all complete lines read - pipelined commands get their replies in one batch */
+static void irmpc_control_lines (struct irmpc_control_client *client)
+{
+    gsize start = 0;
+
+    for (gsize i = 0; i < client->in->len; i++) {
+        if (client->in->str[i] != '\n') continue;
+
+        client->in->str[i] = '\0';
+        if ((i > start) && (client->in->str[i - 1] == '\r')) client->in->str[i - 1] = '\0';
+
+        if (client->discard) {
+            client->discard = false;
+        } else if (client->in->str[start] != '\0') {
+            irmpc_control_line (client, &(client->in->str[start]));
+        }
+        start = i + 1;
+    }
+    g_string_erase (client->in, 0, start);
+
+    if (client->in->len > IRMPC_CONTROL_LINE_MAX) {
+        if (!client->discard) {
+            g_string_append (client->out, "ACK line too long\n");
+        }
+        client->discard = true;
+        g_string_truncate (client->in, 0);
+    }
+}
+
+static gboolean irmpc_control_client_io (gint fd, GIOCondition condition, gpointer data);
+
+/* watch for output space only while replies are waiting */
+static void irmpc_control_client_watch (struct irmpc_control_client *client)
+{
+    bool writing = (client->out->len > 0);
+
+    if ((client->watch_id != 0) && (writing == client->writing)) return;
+
+    if (client->watch_id != 0) {
+        g_source_remove (client->watch_id);
+    }
+
+    client->writing  = writing;
+    client->watch_id = g_unix_fd_add (client->fd, G_IO_IN | G_IO_HUP | G_IO_ERR | (writing ? G_IO_OUT : 0), irmpc_control_client_io, client);
+}
+
+/* write as many replies as possible - false if client is gone */
+static bool irmpc_control_client_flush (struct irmpc_control_client *client)
+{
+    while (client->out->len > 0) {
+        ssize_t len = send (client->fd, client->out->str, client->out->len, MSG_NOSIGNAL);
+
+        if (len < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        g_string_erase (client->out, 0, len);
+    }
+
+    if (client->out->len > IRMPC_CONTROL_OUT_MAX) {
+        fprintf (stderr, "WARNING: control client not reading replies - disconnecting\n");
+        return false;
+    }
+
+    return true;
+}
+
+static gboolean irmpc_control_client_io (gint fd, GIOCondition condition, gpointer data)
+{
+    struct irmpc_control_client *client = data;
+    bool                         closed = false;
+
+    if (condition & G_IO_IN) {
+        char    buffer [4096];
+        ssize_t len;
+
+        while ((len = read (fd, buffer, sizeof (buffer))) > 0) {
+            g_string_append_len (client->in, buffer, len);
+            irmpc_control_lines (client);
+        }
+
+        if ((len == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+            closed = true;
+        }
+    } else if (condition & (G_IO_HUP | G_IO_ERR)) {
+        closed = true;
+    }
+
+    /* replies to lines received before closing are still sent if possible */
+    if ((!irmpc_control_client_flush (client)) || closed) {
+        client->watch_id = 0;
+        irmpc_control_client_close (client);
+        return G_SOURCE_REMOVE;
+    }
+
+    irmpc_control_client_watch (client);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean irmpc_control_accept (gint fd, GIOCondition condition, gpointer data)
+{
+    int client_fd;
+
+    while ((client_fd = accept (fd, NULL, NULL)) != -1) {
+        struct irmpc_control_client *client = g_new0 (struct irmpc_control_client, 1);
+
+        fcntl (client_fd, F_SETFL, fcntl (client_fd, F_GETFL) | O_NONBLOCK);
+        fcntl (client_fd, F_SETFD, FD_CLOEXEC);
+
+        client->fd  = client_fd;
+        client->in  = g_string_new (NULL);
+        client->out = g_string_new (NULL);
+
+        irmpc_control_client_watch (client);
+        control_clients = g_list_prepend (control_clients, client);
+
+        if (irmpc_options.debug) {
+            printf ("INFO: control client %d connected\n", client_fd);
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* listen on control socket if configured */
+bool irmpc_control_init ()
+{
+    if (irmpc_options.control_socket == NULL) return true;
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen (irmpc_options.control_socket) >= sizeof (address.sun_path)) {
+        fprintf (stderr, "ERROR: control socket path too long: %s\n", irmpc_options.control_socket);
+        return false;
+    }
+    strcpy (address.sun_path, irmpc_options.control_socket);
+
+    /* socket left over from previous run */
+    struct stat st;
+    if ((stat (irmpc_options.control_socket, &st) == 0) && S_ISSOCK (st.st_mode)) {
+        unlink (irmpc_options.control_socket);
+    }
+
+    control_fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (control_fd == -1) {
+        fprintf (stderr, "ERROR: failed to create control socket: %s\n", strerror (errno));
+        return false;
+    }
+
+    if ((bind (control_fd, (struct sockaddr *) &address, sizeof (address)) != 0) || (listen (control_fd, 8) != 0)) {
+        fprintf (stderr, "ERROR: failed to listen on control socket %s: %s\n", irmpc_options.control_socket, strerror (errno));
+        close (control_fd);
+        control_fd = -1;
+        return false;
+    }
+
+    control_path     = g_strdup (irmpc_options.control_socket);
+    control_watch_id = g_unix_fd_add (control_fd, G_IO_IN, irmpc_control_accept, NULL);
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: listening for commands on %s\n", irmpc_options.control_socket);
+    }
+
+    return true;
+}
+
+void irmpc_control_free ()
+{
+    g_list_free_full (control_clients, (GDestroyNotify) irmpc_control_client_free);
+    control_clients = NULL;
+
+    if (control_watch_id != 0) {
+        g_source_remove (control_watch_id);
+        control_watch_id = 0;
+    }
+
+    if (control_fd != -1) {
+        close (control_fd);
+        control_fd = -1;
+        unlink (control_path);
+    }
+
+    g_free (control_path);
+    control_path = NULL;
+}
@@ -0,0 +1,9 @@
+#ifndef __control_h__
+#define __control_h__
+
+#include <stdbool.h>
+
+bool irmpc_control_init ();
+void irmpc_control_free ();
+
+#endif
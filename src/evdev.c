@@ -0,0 +1,447 @@
+#include "evdev.h"
+#include "options.h"
+#include "command.h"
+#include "irhandler.h"
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <linux/input.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+/* delay before looking for lost input devices again - doubled up to max */
+#define IRMPC_EVDEV_RESCAN_S     1
+#define IRMPC_EVDEV_RESCAN_MAX_S 8
+
+/* key names usable as button in lircrc - as used by lircd devinput driver */
+#define IRMPC_EVDEV_KEY(name) {#name, name}
+
+static const struct irmpc_evdev_key {
+    const char   *name;
+    unsigned int  code;
+} irmpc_evdev_keys [] = {
+    IRMPC_EVDEV_KEY (KEY_0),           IRMPC_EVDEV_KEY (KEY_1),            IRMPC_EVDEV_KEY (KEY_2),
+    IRMPC_EVDEV_KEY (KEY_3),           IRMPC_EVDEV_KEY (KEY_4),            IRMPC_EVDEV_KEY (KEY_5),
+    IRMPC_EVDEV_KEY (KEY_6),           IRMPC_EVDEV_KEY (KEY_7),            IRMPC_EVDEV_KEY (KEY_8),
+    IRMPC_EVDEV_KEY (KEY_9),           IRMPC_EVDEV_KEY (KEY_NUMERIC_0),    IRMPC_EVDEV_KEY (KEY_NUMERIC_1),
+    IRMPC_EVDEV_KEY (KEY_NUMERIC_2),   IRMPC_EVDEV_KEY (KEY_NUMERIC_3),    IRMPC_EVDEV_KEY (KEY_NUMERIC_4),
+    IRMPC_EVDEV_KEY (KEY_NUMERIC_5),   IRMPC_EVDEV_KEY (KEY_NUMERIC_6),    IRMPC_EVDEV_KEY (KEY_NUMERIC_7),
+    IRMPC_EVDEV_KEY (KEY_NUMERIC_8),   IRMPC_EVDEV_KEY (KEY_NUMERIC_9),    IRMPC_EVDEV_KEY (KEY_UP),
+    IRMPC_EVDEV_KEY (KEY_DOWN),        IRMPC_EVDEV_KEY (KEY_LEFT),         IRMPC_EVDEV_KEY (KEY_RIGHT),
+    IRMPC_EVDEV_KEY (KEY_OK),          IRMPC_EVDEV_KEY (KEY_ENTER),        IRMPC_EVDEV_KEY (KEY_SELECT),
+    IRMPC_EVDEV_KEY (KEY_BACK),        IRMPC_EVDEV_KEY (KEY_EXIT),         IRMPC_EVDEV_KEY (KEY_ESC),
+    IRMPC_EVDEV_KEY (KEY_MENU),        IRMPC_EVDEV_KEY (KEY_HOME),         IRMPC_EVDEV_KEY (KEY_INFO),
+    IRMPC_EVDEV_KEY (KEY_PLAY),        IRMPC_EVDEV_KEY (KEY_PAUSE),        IRMPC_EVDEV_KEY (KEY_PLAYPAUSE),
+    IRMPC_EVDEV_KEY (KEY_STOP),        IRMPC_EVDEV_KEY (KEY_NEXT),         IRMPC_EVDEV_KEY (KEY_PREVIOUS),
+    IRMPC_EVDEV_KEY (KEY_NEXTSONG),    IRMPC_EVDEV_KEY (KEY_PREVIOUSSONG), IRMPC_EVDEV_KEY (KEY_REWIND),
+    IRMPC_EVDEV_KEY (KEY_FASTFORWARD), IRMPC_EVDEV_KEY (KEY_RECORD),       IRMPC_EVDEV_KEY (KEY_EJECTCD),
+    IRMPC_EVDEV_KEY (KEY_VOLUMEUP),    IRMPC_EVDEV_KEY (KEY_VOLUMEDOWN),   IRMPC_EVDEV_KEY (KEY_MUTE),
+    IRMPC_EVDEV_KEY (KEY_POWER),       IRMPC_EVDEV_KEY (KEY_POWER2),       IRMPC_EVDEV_KEY (KEY_SLEEP),
+    IRMPC_EVDEV_KEY (KEY_CHANNELUP),   IRMPC_EVDEV_KEY (KEY_CHANNELDOWN),  IRMPC_EVDEV_KEY (KEY_PAGEUP),
+    IRMPC_EVDEV_KEY (KEY_PAGEDOWN),    IRMPC_EVDEV_KEY (KEY_RED),          IRMPC_EVDEV_KEY (KEY_GREEN),
+    IRMPC_EVDEV_KEY (KEY_YELLOW),      IRMPC_EVDEV_KEY (KEY_BLUE),         IRMPC_EVDEV_KEY (KEY_DELETE),
+    IRMPC_EVDEV_KEY (KEY_CLEAR),       IRMPC_EVDEV_KEY (KEY_SHUFFLE),      IRMPC_EVDEV_KEY (KEY_MEDIA_REPEAT),
+    IRMPC_EVDEV_KEY (KEY_AUDIO),       IRMPC_EVDEV_KEY (KEY_VIDEO),        IRMPC_EVDEV_KEY (KEY_TV),
+    IRMPC_EVDEV_KEY (KEY_RADIO),       IRMPC_EVDEV_KEY (KEY_TUNER),        IRMPC_EVDEV_KEY (KEY_CD),
+    IRMPC_EVDEV_KEY (KEY_DVD),         IRMPC_EVDEV_KEY (KEY_MEDIA),        IRMPC_EVDEV_KEY (KEY_PLAYER),
+    IRMPC_EVDEV_KEY (KEY_EPG),         IRMPC_EVDEV_KEY (KEY_PROGRAM),      IRMPC_EVDEV_KEY (KEY_TEXT),
+    IRMPC_EVDEV_KEY (KEY_SUBTITLE),    IRMPC_EVDEV_KEY (KEY_LANGUAGE),     IRMPC_EVDEV_KEY (KEY_TITLE),
+    IRMPC_EVDEV_KEY (KEY_FAVORITES),   IRMPC_EVDEV_KEY (KEY_LIST),         IRMPC_EVDEV_KEY (KEY_LAST),
+    IRMPC_EVDEV_KEY (KEY_AGAIN),       IRMPC_EVDEV_KEY (KEY_ZOOM),         IRMPC_EVDEV_KEY (KEY_MODE),
+    IRMPC_EVDEV_KEY (KEY_SETUP),       IRMPC_EVDEV_KEY (KEY_OPTION),       IRMPC_EVDEV_KEY (KEY_CONTEXT_MENU),
+    IRMPC_EVDEV_KEY (KEY_SPACE),       IRMPC_EVDEV_KEY (KEY_F1),           IRMPC_EVDEV_KEY (KEY_F2),
+    IRMPC_EVDEV_KEY (KEY_F3),          IRMPC_EVDEV_KEY (KEY_F4),           IRMPC_EVDEV_KEY (KEY_PVR),
+    {NULL}
+};
+
+/* command of lircrc entry - repeat: every n-th key repeat runs it too (0: first press only) */
+struct irmpc_evdev_binding {
+    struct irmpc_command command;
+    unsigned int         repeat;
+};
+
+/* bindings by key code */
+struct irmpc_evdev_keymap {
+    GArray *keys [KEY_CNT];
+};
+
+/* opened input device + repeat counter of its last key */
+struct irmpc_evdev_device {
+    int          fd;
+    guint        watch_id;
+    gchar       *path;
+    unsigned int code;
+    unsigned int repeat;
+};
+
+static struct irmpc_evdev_keymap *evdev_keymap       = NULL;
+static GList                     *evdev_devices      = NULL;
+/* device patterns of startup + number of devices open at best - lost ones are looked for until back */
+static gchar                    **evdev_patterns     = NULL;
+static unsigned int               evdev_wanted       = 0;
+static guint                      evdev_rescan_id    = 0;
+static unsigned int               evdev_rescan_delay = IRMPC_EVDEV_RESCAN_S;
+
+/* key code of button name: KEY_* name or number */
+static int irmpc_evdev_key_code (const char *name)
+{
+    for (const struct irmpc_evdev_key *key = &(irmpc_evdev_keys[0]); key->name != NULL; key++) {
+        if (strcmp (key->name, name) == 0) return key->code;
+    }
+
+    char     *endptr;
+    long int  code = strtol (name, &endptr, 0);
+    if ((name[0] != '\0') && (*endptr == '\0') && (code > 0) && (code < KEY_CNT)) return code;
+
+    return -1;
+}
+
+static void irmpc_evdev_keymap_free (struct irmpc_evdev_keymap *keymap)
+{
+    if (keymap == NULL) return;
+
+    for (unsigned int code = 0; code < KEY_CNT; code++) {
+        if (keymap->keys[code] != NULL) {
+            g_array_free (keymap->keys[code], true);
+        }
+    }
+    g_free (keymap);
+}
+
+/* add lircrc entry read so far - only single button entries for this program */
+static void irmpc_evdev_keymap_entry (struct irmpc_evdev_keymap *keymap, const char *prog, GPtrArray *buttons, GPtrArray *configs, unsigned int repeat)
+{
+    if ((prog == NULL) || (strcmp (prog, irmpc_options.progname) != 0)) return;
+
+    if (buttons->len != 1) {
+        fprintf (stderr, "WARNING: ignoring lirc config entry with %u buttons - only single buttons supported\n", buttons->len);
+        return;
+    }
+
+    const char *button = g_ptr_array_index (buttons, 0);
+    int         code   = irmpc_evdev_key_code (button);
+    if (code < 0) {
+        fprintf (stderr, "WARNING: ignoring button %s in lirc config - no input event key\n", button);
+        return;
+    }
+
+    for (unsigned int i = 0; i < configs->len; i++) {
+        struct irmpc_evdev_binding binding = {.repeat = repeat};
+        const char *config = g_ptr_array_index (configs, i);
+
+        if (!irmpc_command_compile (config, &(binding.command))) {
+            fprintf (stderr, "WARNING: ignoring command \"%s\" in lirc config - unknown\n", config);
+            continue;
+        }
+
+        if (keymap->keys[code] == NULL) {
+            keymap->keys[code] = g_array_new (false, false, sizeof (struct irmpc_evdev_binding));
+        }
+        g_array_append_val (keymap->keys[code], binding);
+    }
+}
+
+/* read button -> command mapping from lircrc (begin/end blocks with prog, button, config, repeat) */
+static struct irmpc_evdev_keymap * irmpc_evdev_keymap_read (const char *lirc_config)
+{
+    gchar  *path     = (lirc_config != NULL) ? g_strdup (lirc_config) : g_build_filename (g_get_home_dir (), ".lircrc", NULL);
+    gchar  *contents = NULL;
+    GError *error    = NULL;
+
+    if (!g_file_get_contents (path, &contents, NULL, &error)) {
+        fprintf (stderr, "ERROR: failed to load lirc config file %s: %s\n", path, error->message);
+        g_error_free (error);
+        g_free (path);
+        return NULL;
+    }
+
+    struct irmpc_evdev_keymap *keymap = g_new0 (struct irmpc_evdev_keymap, 1);
+
+    gchar      **lines   = g_strsplit (contents, "\n", 0);
+    GPtrArray   *buttons = g_ptr_array_new ();
+    GPtrArray   *configs = g_ptr_array_new ();
+    const char  *prog    = NULL;
+    unsigned int repeat  = 0;
+    bool         entry   = false;
+    unsigned int modes   = 0;
+    unsigned int count   = 0;
+
+    for (int i = 0; lines[i] != NULL; i++) {
+        gchar *line = g_strstrip (lines[i]);
+        if ((line[0] == '\0') || (line[0] == '#')) continue;
+
+        gchar *value = strchr (line, '=');
+        if (value != NULL) {
+            *value = '\0';
+            value  = g_strstrip (value + 1);
+            line   = g_strstrip (line);
+        }
+
+        if (g_str_has_prefix (line, "begin")) {
+            /* "begin <mode>": entries only active in lirc mode */
+            if (line[5] != '\0') {
+                modes++;
+            } else {
+                entry  = true;
+                prog   = NULL;
+                repeat = 0;
+                g_ptr_array_set_size (buttons, 0);
+                g_ptr_array_set_size (configs, 0);
+            }
+        } else if (g_str_has_prefix (line, "end")) {
+            if (line[3] != '\0') {
+                if (modes > 0) modes--;
+            } else if (entry) {
+                entry = false;
+                if (modes == 0) {
+                    irmpc_evdev_keymap_entry (keymap, prog, buttons, configs, repeat);
+                    count++;
+                }
+            }
+        } else if (entry && (value != NULL)) {
+            if (strcmp (line, "prog") == 0) {
+                prog = value;
+            } else if (strcmp (line, "button") == 0) {
+                g_ptr_array_add (buttons, value);
+            } else if (strcmp (line, "config") == 0) {
+                g_ptr_array_add (configs, value);
+            } else if (strcmp (line, "repeat") == 0) {
+                repeat = strtoul (value, NULL, 10);
+            }
+        } else if (g_str_has_prefix (line, "include")) {
+            fprintf (stderr, "WARNING: include in lirc config not supported with evdev input\n");
+        }
+    }
+
+    if (irmpc_options.debug) {
+        printf ("INFO: read %u entries from lirc config %s for evdev input\n", count, path);
+    }
+
+    g_ptr_array_free (buttons, true);
+    g_ptr_array_free (configs, true);
+    g_strfreev (lines);
+    g_free (contents);
+    g_free (path);
+
+    return keymap;
+}
+
+/* run commands bound to key - lirc semantics for repeats */
+static void irmpc_evdev_key (unsigned int code, unsigned int repeat)
+{
+    GArray *bindings = evdev_keymap->keys[code];
+    if (bindings == NULL) return;
+
+    for (unsigned int i = 0; i < bindings->len; i++) {
+        struct irmpc_evdev_binding *binding = &g_array_index (bindings, struct irmpc_evdev_binding, i);
+
+        if ((repeat > 0) && ((binding->repeat == 0) || (repeat % binding->repeat != 0))) continue;
+
+        if (irmpc_options.debug) {
+            printf ("Got command: \"%c:%s\"\n", "mvps"[binding->command.type], binding->command.arg);
+        }
+
+        struct irmpc_command command = binding->command;
+        command.repeat = repeat;
+        irmpc_irhandler_command (&command);
+    }
+}
+
+static void irmpc_evdev_device_free (struct irmpc_evdev_device *device)
+{
+    if (device->watch_id != 0) {
+        g_source_remove (device->watch_id);
+    }
+
+    close (device->fd);
+    g_free (device->path);
+    g_free (device);
+}
+
+static void irmpc_evdev_rescan_start ();
+
+/* device readable: handle key presses (1) and autorepeats (2) */
+static gboolean irmpc_evdev_input (gint fd, GIOCondition condition, gpointer data)
+{
+    struct irmpc_evdev_device *device = data;
+    struct input_event         events [64];
+    ssize_t                    len;
+
+    while ((len = read (fd, events, sizeof (events))) > 0) {
+        for (unsigned int i = 0; i < len / sizeof (struct input_event); i++) {
+            if ((events[i].type != EV_KEY) || (events[i].code >= KEY_CNT)) continue;
+
+            if (events[i].value == 1) {
+                device->code   = events[i].code;
+                device->repeat = 0;
+            } else if ((events[i].value == 2) && (events[i].code == device->code)) {
+                device->repeat++;
+            } else {
+                continue;
+            }
+
+            irmpc_evdev_key (device->code, device->repeat);
+        }
+    }
+
+    if ((len == 0) || ((errno != EAGAIN) && (errno != EINTR)) || (condition & (G_IO_HUP | G_IO_ERR))) {
+        fprintf (stderr, "ERROR: input device %s lost - looking for it again\n", device->path);
+
+        device->watch_id = 0;
+        evdev_devices = g_list_remove (evdev_devices, device);
+        irmpc_evdev_device_free (device);
+
+        irmpc_evdev_rescan_start ();
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* open device if it has any key of keymap and is not open already */
+static void irmpc_evdev_open (const char *path)
+{
+    unsigned long bits [KEY_CNT / (8 * sizeof (unsigned long)) + 1] = {0};
+
+    for (GList *item = evdev_devices; item != NULL; item = item->next) {
+        if (strcmp (((struct irmpc_evdev_device *) item->data)->path, path) == 0) return;
+    }
+
+    int fd = open (path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        if (irmpc_options.debug) {
+            printf ("INFO: cannot open input device %s: %s\n", path, strerror (errno));
+        }
+        return;
+    }
+
+    bool used = false;
+    if (ioctl (fd, EVIOCGBIT (EV_KEY, sizeof (bits)), bits) >= 0) {
+        for (unsigned int code = 0; (!used) && (code < KEY_CNT); code++) {
+            bool has_key = (bits[code / (8 * sizeof (unsigned long))] >> (code % (8 * sizeof (unsigned long)))) & 1;
+            used = has_key && (evdev_keymap->keys[code] != NULL);
+        }
+    }
+
+    if (!used) {
+        close (fd);
+        return;
+    }
+
+    struct irmpc_evdev_device *device = g_new0 (struct irmpc_evdev_device, 1);
+
+    device->fd       = fd;
+    device->path     = g_strdup (path);
+    device->watch_id = g_unix_fd_add (fd, G_IO_IN | G_IO_HUP | G_IO_ERR, irmpc_evdev_input, device);
+
+    evdev_devices = g_list_prepend (evdev_devices, device);
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: reading keys from input device %s\n", path);
+    }
+}
+
+/* open all devices of patterns not open yet */
+static void irmpc_evdev_scan ()
+{
+    for (int i = 0; evdev_patterns[i] != NULL; i++) {
+        glob_t paths;
+
+        if (glob (evdev_patterns[i], 0, NULL, &paths) != 0) continue;
+
+        for (size_t p = 0; p < paths.gl_pathc; p++) {
+            irmpc_evdev_open (paths.gl_pathv[p]);
+        }
+        globfree (&paths);
+    }
+
+    if (g_list_length (evdev_devices) > evdev_wanted) {
+        evdev_wanted = g_list_length (evdev_devices);
+    }
+}
+
+static gboolean irmpc_evdev_rescan (gpointer data)
+{
+    evdev_rescan_id = 0;
+
+    irmpc_evdev_scan ();
+
+    if (g_list_length (evdev_devices) < evdev_wanted) {
+        if (evdev_devices == NULL) {
+            fprintf (stderr, "WARNING: no input device found - trying again in %u s\n", evdev_rescan_delay);
+        }
+        evdev_rescan_id    = g_timeout_add_seconds (evdev_rescan_delay, irmpc_evdev_rescan, NULL);
+        evdev_rescan_delay = MIN (evdev_rescan_delay * 2, IRMPC_EVDEV_RESCAN_MAX_S);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* device lost: look for it (or its replacement after replugging) until back */
+static void irmpc_evdev_rescan_start ()
+{
+    evdev_rescan_delay = IRMPC_EVDEV_RESCAN_S;
+
+    if (evdev_rescan_id != 0) g_source_remove (evdev_rescan_id);
+    evdev_rescan_id = g_timeout_add_seconds (evdev_rescan_delay, irmpc_evdev_rescan, NULL);
+}
+
+/* read keymap from lircrc and open input devices (paths or patterns separated by ',') */
+bool irmpc_evdev_init ()
+{
+    evdev_keymap = irmpc_evdev_keymap_read (irmpc_options.lirc_config);
+    if (evdev_keymap == NULL) return false;
+
+    evdev_patterns = g_strsplit (irmpc_options.input_devices, ",", 0);
+    for (int i = 0; evdev_patterns[i] != NULL; i++) {
+        g_strstrip (evdev_patterns[i]);
+    }
+
+    irmpc_evdev_scan ();
+
+    if (evdev_devices == NULL) {
+        fprintf (stderr, "ERROR: no input device with keys of lirc config found in %s\n", irmpc_options.input_devices);
+        return false;
+    }
+
+    return true;
+}
+
+/* read lircrc again - old mapping is kept on errors
+ * devices are scanned again: ones with keys only new mapping uses get opened */
+bool irmpc_evdev_reload (const char *lirc_config)
+{
+    struct irmpc_evdev_keymap *keymap = irmpc_evdev_keymap_read (lirc_config);
+    if (keymap == NULL) return false;
+
+    irmpc_evdev_keymap_free (evdev_keymap);
+    evdev_keymap = keymap;
+
+    irmpc_evdev_scan ();
+
+    return true;
+}
+
+void irmpc_evdev_free ()
+{
+    g_list_free_full (evdev_devices, (GDestroyNotify) irmpc_evdev_device_free);
+    evdev_devices = NULL;
+
+    irmpc_evdev_keymap_free (evdev_keymap);
+    evdev_keymap = NULL;
+
+    if (evdev_rescan_id != 0) {
+        g_source_remove (evdev_rescan_id);
+        evdev_rescan_id = 0;
+    }
+
+    g_strfreev (evdev_patterns);
+    evdev_patterns = NULL;
+    evdev_wanted   = 0;
+}
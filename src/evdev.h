@@ -0,0 +1,11 @@
+#ifndef __evdev_h__
+#define __evdev_h__
+
+#include <stdbool.h>
+
+/* lost input devices are looked for again until they are back */
+bool irmpc_evdev_init   ();
+bool irmpc_evdev_reload (const char *lirc_config);
+void irmpc_evdev_free   ();
+
+#endif
@@ -0,0 +1,57 @@
+#include "gesture.h"
+#include "options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* feed key event - repeat: lirc repeat counter (0: new press)
+ * returns number of presses within keytimespan of each other */
+unsigned int irmpc_gesture_feed (struct irmpc_gesture *gesture, int64_t now, unsigned int repeat)
+{
+    int64_t timediff = now - gesture->last_time;
+    bool    in_span  = (gesture->last_time != 0) && (timediff <= (int64_t) irmpc_options.lirc_key_timespan_ms * 1000);
+
+    if (irmpc_options.debug && (gesture->last_time != 0)) {
+        printf ("INFO: timediff to last press: %lldms (repeat %u)\n", (long long) (timediff / 1000), repeat);
+    }
+
+    if ((repeat > 0) && in_span) {
+        /* key still held */
+        gesture->last_time = now;
+        return gesture->taps;
+    }
+
+    if (!in_span) gesture->taps = 0;
+
+    gesture->taps++;
+    gesture->first_time = now;
+    gesture->last_time  = now;
+    gesture->consumed   = false;
+
+    return gesture->taps;
+}
+
+/* current press held for longpress time and not consumed yet */
+bool irmpc_gesture_long (const struct irmpc_gesture *gesture)
+{
+    if (gesture->consumed || (irmpc_options.lirc_longpress_ms == 0)) return false;
+
+    return (gesture->last_time - gesture->first_time >= (int64_t) irmpc_options.lirc_longpress_ms * 1000);
+}
+
+/* action taken: restart counting, ignore rest of held press */
+void irmpc_gesture_consume (struct irmpc_gesture *gesture)
+{
+    gesture->taps     = 0;
+    gesture->consumed = true;
+}
+
+/* repeat counter of lirc code string "<code> <repeat> <button> <remote>" */
+unsigned int irmpc_gesture_lirc_repeat (const char *code)
+{
+    const char *c = code;
+
+    while ((*c != ' ') && (*c != '\0')) c++;
+
+    return (unsigned int) strtoul (c, NULL, 16);
+}
@@ -0,0 +1,24 @@
+#ifndef __gesture_h__
+#define __gesture_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* multi-press / long-press state of one key
+ * times are monotonic in us (g_get_monotonic_time) */
+struct irmpc_gesture {
+    int64_t      first_time;    /* start of currently held press */
+    int64_t      last_time;     /* last event of key */
+    unsigned int taps;          /* presses within keytimespan of each other */
+    bool         consumed;      /* action taken - wait for new press */
+};
+
+#define IRMPC_GESTURE_INIT {0, 0, 0, false}
+
+unsigned int irmpc_gesture_feed    (struct irmpc_gesture *gesture, int64_t now, unsigned int repeat);
+bool         irmpc_gesture_long    (const struct irmpc_gesture *gesture);
+void         irmpc_gesture_consume (struct irmpc_gesture *gesture);
+
+unsigned int irmpc_gesture_lirc_repeat (const char *code);
+
+#endif
@@ -1,149 +1,494 @@
 #include "irhandler.h"
 #include "options.h"
+#include "command.h"
+#include "gesture.h"
+#include "phash.h"
 #include "mpd.h"
+#include "evdev.h"
+#include "trace.h"
 
 #ifndef DEBUG_NO_LIRC
 #include <lirc/lirc_client.h>
 #endif
 
+#include <glib-unix.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <unistd.h>
 
 
-static int    power_last_press = -1;
-static time_t power_last_time;
+/* maximum time to wait for mpd stop before executing poweroff command */
+#define IRMPC_POWEROFF_STOP_TIMEOUT_MS 5000
+/* maximum time to wait for replayed commands to be executed before quitting */
+#define IRMPC_REPLAY_DRAIN_TIMEOUT_MS  10000
 
-static void system_handler (const char *command)
-{
-    if (strcmp (command, "poweroff") == 0) {
-        time_t this_time = time (NULL);
-
-        int power_press = 1;
+/* power key presses */
+static struct irmpc_gesture power_gesture = IRMPC_GESTURE_INIT;
 
-        if (power_last_press >= 0) {
-            double timediff = difftime (this_time, power_last_time);
-            if (irmpc_options.debug) {
-                printf ("INFO: timediff to last press: %fs\n", timediff);
-            }
-            if (timediff <= irmpc_options.lirc_key_timespan) {
-                power_press += power_last_press;
-            }
-        }
+static void system_handler (const struct irmpc_command *command)
+{
+    if (command->op == IRMPC_OP_POWEROFF) {
+        unsigned int power_press = irmpc_gesture_feed (&power_gesture, g_get_monotonic_time (), command->repeat);
 
-        if (power_press >= irmpc_options.power_amount) {
+        if ((power_press >= irmpc_options.power_amount) || irmpc_gesture_long (&power_gesture)) {
             if (irmpc_options.power_command != NULL) {
                 if (irmpc_options.debug) {
                     printf ("INFO: executing poweroff command: %s\n", irmpc_options.power_command);
                 }
 
                 /* stop on poweroff */
-                irmpc_mpd_command ("stop");
+                struct irmpc_command stop = {
+                    .type = IRMPC_COMMAND_MPD,
+                    .op   = IRMPC_OP_STOP,
+                    .arg  = "stop"
+                };
+                irmpc_mpd_push (&stop);
+                irmpc_mpd_wait (IRMPC_POWEROFF_STOP_TIMEOUT_MS);
                 system (irmpc_options.power_command);
             } else {
                 fprintf (stderr, "WARNING: no poweroff command specified\n");
             }
 
-            power_press = 0;
+            irmpc_gesture_consume (&power_gesture);
         }
+    } else if (command->op == IRMPC_OP_ROOM) {
+        /* held key selects only once */
+        if (command->repeat == 0) {
+            irmpc_mpd_select (strchr (command->arg, ':') + 1);
+        }
+    }
+}
 
-        power_last_press = power_press;
-        power_last_time  = time (NULL);
+/* run compiled command */
+static bool irmpc_irhandler_run (const struct irmpc_command *command)
+{
+    irmpc_trace_record (command);
+
+    switch (command->type) {
+        case IRMPC_COMMAND_SYSTEM:
+            system_handler (command);
+            break;
+        case IRMPC_COMMAND_MPD:
+        case IRMPC_COMMAND_VOLUME:
+        case IRMPC_COMMAND_PLAYLIST:
+            return irmpc_mpd_push (command);
     }
+
+    return true;
 }
 
-bool irmpc_irhandler ()
+/* run command from other input (control socket) - false if not passed on */
+bool irmpc_irhandler_command (const struct irmpc_command *command)
 {
+    return irmpc_irhandler_run (command);
+}
+
+/* config string of lirc config with its compiled command */
+struct irmpc_irhandler_entry {
+    gchar                *string;
+    struct irmpc_command  command;
+};
+
+/* config strings of lirc config compiled at startup - looked up by string hash */
+static struct irmpc_phash  irhandler_dispatch_hash = {0};
+static GArray             *irhandler_dispatch      = NULL;
+
+/* free dispatch table entries */
+static void irmpc_irhandler_dispatch_free (GArray *dispatch)
+{
+    if (dispatch == NULL) return;
+
+    for (unsigned int i = 0; i < dispatch->len; i++) {
+        g_free (g_array_index (dispatch, struct irmpc_irhandler_entry, i).string);
+    }
+    g_array_free (dispatch, true);
+}
+
+/* dispatch one command string to its handler */
+static void irmpc_irhandler_dispatch (const char *c, unsigned int repeat)
+{
+    if (irmpc_options.debug) {
+        printf ("Got command: \"%s\"\n", c);
+    }
+
+    int index = irmpc_phash_lookup (&irhandler_dispatch_hash, irmpc_phash_string (c));
+    if ((index >= 0) && (strcmp (g_array_index (irhandler_dispatch, struct irmpc_irhandler_entry, index).string, c) == 0)) {
+        const struct irmpc_irhandler_entry *entry = &g_array_index (irhandler_dispatch, struct irmpc_irhandler_entry, index);
+
+        /* unknown ones are reported at startup already */
+        if (entry->command.op != IRMPC_OP_UNKNOWN) {
+            struct irmpc_command command = entry->command;
+            command.repeat = repeat;
+            irmpc_irhandler_run (&command);
+        }
+        return;
+    }
+
+    /* string not from config: compile now */
+    struct irmpc_command command;
+    if (!irmpc_command_compile (c, &command)) {
+        fprintf (stderr, "WARNING: ignoring command \"%s\" - unknown\n", c);
+        return;
+    }
+
+    command.repeat = repeat;
+    irmpc_irhandler_run (&command);
+}
+
+/* source of key presses - selected by input option */
+enum irmpc_irhandler_source {
+    IRMPC_INPUT_LIRC,
+    IRMPC_INPUT_EVDEV,
+    IRMPC_INPUT_STDIN,
+    IRMPC_INPUT_REPLAY
+};
+
+/* main loop to quit when input is closed */
+static GMainLoop                   *irhandler_loop     = NULL;
+static enum irmpc_irhandler_source  irhandler_source   = IRMPC_INPUT_LIRC;
+/* event source watching the input fd */
+static guint                        irhandler_watch_id = 0;
+
 #ifndef DEBUG_NO_LIRC
-    bool connected   = false;
-    time_t wait_time = 1;
-
-    for (int i = 0; i < irmpc_options.lircd_tries; i++) {
-        if (lirc_init (irmpc_options.progname, 1) == -1) {
-            fprintf (stderr, "ERROR: failed to initialize lirc - trying again in %ld s.\n", wait_time);
-            struct timespec waittime = {wait_time, 0};
-            nanosleep (&waittime, NULL);
-            wait_time *= 2;
-        } else {
-            connected = true;
-            break;
+static struct lirc_config *irhandler_config = NULL;
+static bool                irhandler_lirc_initialized = false;
+
+/* compile all distinct config strings of lirc config into dispatch table
+ * keyed on string contents - independent of the buffers liblirc keeps them in */
+static bool irmpc_irhandler_compile (struct lirc_config *config, struct irmpc_phash *hash, GArray **dispatch)
+{
+    GArray     *keys    = g_array_new (false, false, sizeof (uint64_t));
+    GArray     *entries = g_array_new (false, false, sizeof (struct irmpc_irhandler_entry));
+    GHashTable *seen    = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (struct lirc_config_entry *entry = config->first; entry != NULL; entry = entry->next) {
+        for (struct lirc_list *string = entry->config; string != NULL; string = string->next) {
+            if (g_hash_table_contains (seen, string->string)) continue;
+            g_hash_table_add (seen, string->string);
+
+            struct irmpc_irhandler_entry compiled = {.string = g_strdup (string->string)};
+            uint64_t                     key      = irmpc_phash_string (string->string);
+
+            if (!irmpc_command_compile (string->string, &(compiled.command))) {
+                fprintf (stderr, "WARNING: ignoring command \"%s\" in lirc config - unknown\n", string->string);
+                compiled.command.op = IRMPC_OP_UNKNOWN;
+            }
+
+            g_array_append_val (keys,    key);
+            g_array_append_val (entries, compiled);
         }
     }
 
-    if (!connected) {
-        fprintf (stderr, "ERROR: failed to initialize lirc - giving up.\n");
-        return false;
+    g_hash_table_destroy (seen);
+
+    if (irmpc_options.debug) {
+        printf ("INFO: compiled %u lirc config strings\n", keys->len);
     }
 
-    struct lirc_config *config;
+    bool success = irmpc_phash_build (hash, (uint64_t *) keys->data, keys->len);
 
-    if (lirc_readconfig (irmpc_options.lirc_config, &config, NULL) != 0) {
-        fprintf (stderr, "ERROR: failed to load lirc config file\n");
-        goto irmpc_irhandler_error_exit;
+    if (success) {
+        *dispatch = entries;
+    } else {
+        fprintf (stderr, "ERROR: failed to build command dispatch table\n");
+        irmpc_irhandler_dispatch_free (entries);
     }
 
-    /* main loop */
+    g_array_free (keys, true);
+
+    return success;
+}
+
+/* lircd socket readable: handle all codes available without blocking */
+static gboolean irmpc_irhandler_lirc_input (gint fd, GIOCondition condition, gpointer data)
+{
     char *code;
+    int   ret;
 
-    while (lirc_nextcode (&code) == 0) {
-        if (code == NULL) continue;
+    while ((ret = lirc_nextcode (&code)) == 0) {
+        /* no more complete code available */
+        if (code == NULL) break;
 
-        int ret;
-        char *c = NULL;
+        char         *c      = NULL;
+        unsigned int  repeat = irmpc_gesture_lirc_repeat (code);
 
-        while (((ret = lirc_code2char (config, code, &c)) == 0) && (c != NULL)) {
-#else
-        char c [1024];
-        while (true) {
-            scanf ("%s", c);
+        while (((ret = lirc_code2char (irhandler_config, code, &c)) == 0) && (c != NULL)) {
+            irmpc_irhandler_dispatch (c, repeat);
+        }
+
+        free (code);
+        if (ret == -1) break;
+    }
+
+    if ((ret == -1) || (condition & (G_IO_HUP | G_IO_ERR))) {
+        fprintf (stderr, "ERROR: connection to lircd lost\n");
+        irhandler_watch_id = 0;
+        g_main_loop_quit (irhandler_loop);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
 #endif
-            if (irmpc_options.debug) {
-                printf ("Got command: \"%s\"\n", c);
-            }
 
-            if (strlen (c) < 3) {
-                fprintf (stderr, "WARNING: ignoring command \"%s\" - too short.\n", c);
-                continue;
-            }
+/* line buffer for command strings read from stdin */
+static GString *irhandler_stdin_buffer = NULL;
 
-            if ((c[0] == 'm') && (c[1] == ':')) {
-                /* mpd command */
-                irmpc_mpd_command (&(c[2]));
-            } else if ((c[0] == 'v') && (c[1] == ':')) {
-                /* volume command */
-                irmpc_mpd_volume (&(c[2]));
-            } else if ((c[0] == 's') && (c[1] == ':')) {
-                /* system command */
-                system_handler (&(c[2]));
-            } else if ((c[0] == 'p') && (c[1] == ':')) {
-                /* playlist command */
-                int number = c[2] - '0';
-                if ((number >= 0) && (number <= 9)) {
-                    irmpc_mpd_playlist_key (number);
-                }
-            } else {
-                fprintf (stderr, "WARNING: ignoring command \"%s\" - unknown\n", c);
-                continue;
+/* stdin readable: handle all whitespace separated command strings */
+static gboolean irmpc_irhandler_stdin_input (gint fd, GIOCondition condition, gpointer data)
+{
+    char    buffer [1024];
+    ssize_t len = read (fd, buffer, sizeof (buffer));
 
+    if (len <= 0) {
+        if ((len < 0) && (errno == EAGAIN)) return G_SOURCE_CONTINUE;
+        irhandler_watch_id = 0;
+        g_main_loop_quit (irhandler_loop);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_string_append_len (irhandler_stdin_buffer, buffer, len);
+
+    /* handle complete words, keep incomplete rest in buffer */
+    gsize start = 0;
+    for (gsize i = 0; i < irhandler_stdin_buffer->len; i++) {
+        if (g_ascii_isspace (irhandler_stdin_buffer->str[i])) {
+            if (i > start) {
+                irhandler_stdin_buffer->str[i] = '\0';
+                irmpc_irhandler_dispatch (&(irhandler_stdin_buffer->str[start]), 0);
             }
+            start = i + 1;
+        }
+    }
+    g_string_erase (irhandler_stdin_buffer, 0, start);
+
+    return G_SOURCE_CONTINUE;
+}
+
+#ifndef DEBUG_NO_LIRC
+/* lircd connection attempts so far + delay before next one */
+static unsigned int irhandler_lirc_tries = 0;
+static unsigned int irhandler_lirc_delay = 1;
+static guint        irhandler_retry_id   = 0;
+#endif
+
+/* input could not be set up after starting main loop */
+static bool   irhandler_failed     = false;
+static gint64 irhandler_start_time = 0;
+
+/* give up on input: leave main loop */
+static void irmpc_irhandler_fail ()
+{
+    irhandler_failed = true;
+    g_main_loop_quit (irhandler_loop);
+}
+
+/* whole trace replayed: leave main loop once mpd has executed it */
+static void irmpc_irhandler_replayed ()
+{
+    irmpc_mpd_wait (IRMPC_REPLAY_DRAIN_TIMEOUT_MS);
+    g_main_loop_quit (irhandler_loop);
+}
+
+/* input can deliver key presses from now on */
+static void irmpc_irhandler_ready ()
+{
+    if (irmpc_options.verbose) {
+        printf ("INFO: input ready %lld ms after start\n", (long long) ((g_get_monotonic_time () - irhandler_start_time) / 1000));
+    }
+}
+
+#ifndef DEBUG_NO_LIRC
+static gboolean irmpc_irhandler_lirc_retry (gpointer data);
+
+/* try connecting to lircd - retried by timer with doubling delay
+ * returns false on errors not worth retrying */
+static bool irmpc_irhandler_lirc_connect ()
+{
+    int fd = lirc_init (irmpc_options.progname, 1);
+    irhandler_lirc_tries++;
 
-#ifdef DEBUG_NO_LIRC
+    if (fd == -1) {
+        if (irhandler_lirc_tries >= irmpc_options.lircd_tries) {
+            fprintf (stderr, "ERROR: failed to initialize lirc - giving up.\n");
+            return false;
         }
+
+        fprintf (stderr, "ERROR: failed to initialize lirc - trying again in %u s.\n", irhandler_lirc_delay);
+        irhandler_retry_id    = g_timeout_add_seconds (irhandler_lirc_delay, irmpc_irhandler_lirc_retry, NULL);
+        irhandler_lirc_delay *= 2;
         return true;
-#else
-        }
+    }
 
-        free (code);
-        if (ret == -1) break;
+    irhandler_lirc_initialized = true;
+
+    if (lirc_readconfig (irmpc_options.lirc_config, &irhandler_config, NULL) != 0) {
+        fprintf (stderr, "ERROR: failed to load lirc config file\n");
+        irhandler_config = NULL;
+        return false;
     }
-    lirc_freeconfig (config);
 
-    lirc_deinit ();
+    if (!irmpc_irhandler_compile (irhandler_config, &irhandler_dispatch_hash, &irhandler_dispatch)) {
+        /* strings get compiled on each press instead */
+        irhandler_dispatch = NULL;
+    }
+
+    /* lirc_nextcode returns without code on non-blocking socket */
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+    irhandler_watch_id = g_unix_fd_add (fd, G_IO_IN | G_IO_HUP | G_IO_ERR, irmpc_irhandler_lirc_input, NULL);
+    irmpc_irhandler_ready ();
+
     return true;
+}
 
-irmpc_irhandler_error_exit:
-    lirc_deinit ();
+static gboolean irmpc_irhandler_lirc_retry (gpointer data)
+{
+    irhandler_retry_id = 0;
+
+    if (!irmpc_irhandler_lirc_connect ()) {
+        irmpc_irhandler_fail ();
+    }
+
+    return G_SOURCE_REMOVE;
+}
+#endif
+
+/* connect input (lircd, evdev devices, stdin or trace replay) to the main loop
+ * lircd not running yet is retried from main loop without blocking */
+bool irmpc_irhandler_init (GMainLoop *loop)
+{
+    irhandler_loop       = loop;
+    irhandler_start_time = g_get_monotonic_time ();
+
+    if ((irmpc_options.trace_record != NULL) && (!irmpc_trace_record_init (irmpc_options.trace_record))) {
+        return false;
+    }
+
+    if (strcmp (irmpc_options.input, "replay") == 0) {
+        irhandler_source = IRMPC_INPUT_REPLAY;
+
+        if (!irmpc_trace_replay_init (irmpc_options.trace_replay, irmpc_options.trace_replay_speed, irmpc_irhandler_replayed)) return false;
+
+        irmpc_irhandler_ready ();
+        return true;
+    }
+
+    if (strcmp (irmpc_options.input, "evdev") == 0) {
+        irhandler_source = IRMPC_INPUT_EVDEV;
+
+        if (!irmpc_evdev_init ()) return false;
+
+        irmpc_irhandler_ready ();
+        return true;
+    }
+
+    if (strcmp (irmpc_options.input, "stdin") == 0) {
+        irhandler_source       = IRMPC_INPUT_STDIN;
+        irhandler_stdin_buffer = g_string_new (NULL);
+        irhandler_watch_id     = g_unix_fd_add (STDIN_FILENO, G_IO_IN | G_IO_HUP | G_IO_ERR, irmpc_irhandler_stdin_input, NULL);
+
+        irmpc_irhandler_ready ();
+        return true;
+    }
+
+    irhandler_source = IRMPC_INPUT_LIRC;
+
+#ifndef DEBUG_NO_LIRC
+    if (irmpc_options.lircd_tries == 0) {
+        fprintf (stderr, "ERROR: failed to initialize lirc - giving up.\n");
+        return false;
+    }
+
+    return irmpc_irhandler_lirc_connect ();
+#else
+    fprintf (stderr, "ERROR: lirc input not compiled in - use evdev or stdin\n");
     return false;
 #endif
 }
+
+/* whether input failed after main loop was started */
+bool irmpc_irhandler_failed ()
+{
+    return irhandler_failed;
+}
+
+/* read lirc config again and swap it in - old one is kept on errors */
+bool irmpc_irhandler_reload (const char *lirc_config)
+{
+    if (irhandler_source == IRMPC_INPUT_EVDEV) {
+        return irmpc_evdev_reload (lirc_config);
+    }
+
+#ifndef DEBUG_NO_LIRC
+    if (irhandler_source != IRMPC_INPUT_LIRC) return true;
+
+    /* still waiting for lircd: new config is read on connecting */
+    if (!irhandler_lirc_initialized) return true;
+
+    struct lirc_config *config   = NULL;
+    struct irmpc_phash  hash     = {0};
+    GArray             *dispatch = NULL;
+
+    if (lirc_readconfig (lirc_config, &config, NULL) != 0) {
+        fprintf (stderr, "ERROR: failed to load lirc config file\n");
+        return false;
+    }
+
+    if (!irmpc_irhandler_compile (config, &hash, &dispatch)) {
+        lirc_freeconfig (config);
+        return false;
+    }
+
+    irmpc_phash_free (&irhandler_dispatch_hash);
+    irmpc_irhandler_dispatch_free (irhandler_dispatch);
+    lirc_freeconfig (irhandler_config);
+
+    irhandler_dispatch_hash = hash;
+    irhandler_dispatch      = dispatch;
+    irhandler_config        = config;
+#endif
+
+    return true;
+}
+
+/* disconnect input */
+void irmpc_irhandler_free ()
+{
+    if (irhandler_watch_id != 0) {
+        g_source_remove (irhandler_watch_id);
+        irhandler_watch_id = 0;
+    }
+
+    irmpc_phash_free (&irhandler_dispatch_hash);
+    irmpc_irhandler_dispatch_free (irhandler_dispatch);
+    irhandler_dispatch = NULL;
+
+    irmpc_evdev_free ();
+    irmpc_trace_free ();
+
+    if (irhandler_stdin_buffer != NULL) {
+        g_string_free (irhandler_stdin_buffer, true);
+        irhandler_stdin_buffer = NULL;
+    }
+
+#ifndef DEBUG_NO_LIRC
+    if (irhandler_retry_id != 0) {
+        g_source_remove (irhandler_retry_id);
+        irhandler_retry_id = 0;
+    }
+
+    if (irhandler_config != NULL) {
+        lirc_freeconfig (irhandler_config);
+        irhandler_config = NULL;
+    }
+
+    if (irhandler_lirc_initialized) {
+        lirc_deinit ();
+        irhandler_lirc_initialized = false;
+    }
+#endif
+}
@@ -1,8 +1,15 @@
 #ifndef __irhandler_h__
 #define __irhandler_h__
 
+#include "command.h"
+
 #include <stdbool.h>
+#include <glib.h>
 
-bool irmpc_irhandler ();
+bool irmpc_irhandler_init    (GMainLoop *loop);
+bool irmpc_irhandler_reload  (const char *lirc_config);
+bool irmpc_irhandler_command (const struct irmpc_command *command);
+bool irmpc_irhandler_failed  ();
+void irmpc_irhandler_free    ();
 
 #endif
@@ -1,27 +1,89 @@
 #include "options.h"
+#include "command.h"
 #include "playlist.h"
 #include "irhandler.h"
+#include "reload.h"
+#include "control.h"
 #include "mpd.h"
 
+#include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdio.h>
+
+/* terminate main loop on signal */
+static gboolean irmpc_signal_quit (gpointer data)
+{
+    GMainLoop *loop = (GMainLoop *) data;
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: received termination signal - shutting down\n");
+    }
+
+    g_main_loop_quit (loop);
+
+    return G_SOURCE_CONTINUE;
+}
+
 int main (int argc, char **argv)
 {
+    GMainLoop *loop = NULL;
+
     if (!irmpc_parse_options (&argc, &argv)) {
         goto exit_error;
     }
 
+    loop = g_main_loop_new (NULL, false);
+
+    /* signal catching */
+    g_unix_signal_add (SIGTERM, irmpc_signal_quit, loop);
+    g_unix_signal_add (SIGINT,  irmpc_signal_quit, loop);
+
+    if (!irmpc_mpd_init ()) {
+        goto exit_error;
+    }
+
+    if (!irmpc_irhandler_init (loop)) {
+        goto exit_error;
+    }
+
+    if (!irmpc_reload_init ()) {
+        goto exit_error;
+    }
+
+    if (!irmpc_control_init ()) {
+        goto exit_error;
+    }
+
     /* main loop ... */
-    irmpc_irhandler ();
+    g_main_loop_run (loop);
 
-    /* TODO: signal catching */
+    if (irmpc_irhandler_failed ()) {
+        goto exit_error;
+    }
 
-    irmpc_playlist_free ();
+    irmpc_control_free ();
+    irmpc_reload_free ();
+    irmpc_irhandler_free ();
     irmpc_mpd_free ();
+    irmpc_playlist_free ();
+    irmpc_command_free ();
+
+    g_main_loop_unref (loop);
 
     return 0;
 
 exit_error:
-    irmpc_playlist_free ();
+    irmpc_control_free ();
+    irmpc_reload_free ();
+    irmpc_irhandler_free ();
     irmpc_mpd_free ();
+    irmpc_playlist_free ();
+    irmpc_command_free ();
+
+    if (loop != NULL) {
+        g_main_loop_unref (loop);
+    }
 
     return 1;
 }
@@ -1,501 +1,1920 @@
 #include "mpd.h"
 #include "options.h"
 #include "playlist.h"
-
+#include "queue.h"
+#include "schedule.h"
+#include "mpdpipe.h"
+#include "mpdqueue.h"
+#include "mpdplaylists.h"
+#include "gesture.h"
+
+#include <glib-unix.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <mpd/client.h>
-#include <time.h>
 
 
 /* update current playlist */
-static void irmpc_mpd_playlist_update ();
+static void irmpc_mpd_playlist_update (const struct irmpc_command *command);
 /* load next/prev playlist */
 static void irmpc_mpd_playlist_nextprev (int direction);
 
 
+/* status flags of a target - for same result of toggles across targets */
+#define IRMPC_MPD_TARGET_PLAYING (1 << 0)
+#define IRMPC_MPD_TARGET_REPEAT  (1 << 1)
+#define IRMPC_MPD_TARGET_SINGLE  (1 << 2)
+#define IRMPC_MPD_TARGET_RANDOM  (1 << 3)
+
+/* mpd server (room) driven by an own executor thread - commands go to all selected ones */
+struct irmpc_mpd_target {
+    gchar                       *name;      /* NULL: single target of hostname option */
+    gchar                       *hosts;
+    GThread                     *thread;
+    GMainContext                *context;
+    GMainLoop                   *loop;
+    /* commands passed from input decoding to executor thread */
+    struct irmpc_queue          *queue;
+    /* playlist table + options snapshot handed to executor thread on start */
+    struct irmpc_playlist_table *table;
+    const struct _irmpc_options *options;
+    /* only used by input thread */
+    bool                         selected;
+    /* IRMPC_MPD_TARGET_* - written by executor, read by input thread */
+    gint                         flags;
+};
+
+static GPtrArray *mpd_targets = NULL;
+
+/* all other state is per executor thread - each one drives own target */
+static __thread struct irmpc_mpd_target *mpd_target  = NULL;
+static __thread GMainContext            *mpd_context = NULL;
+static __thread struct irmpc_queue      *mpd_queue   = NULL;
+
 /* mpd connection */
-static struct mpd_connection *connection = NULL;
+static __thread struct mpd_connection *connection = NULL;
 
-/* check whether connection is working - try (re)connecting if not */
-static bool irmpc_connection_check ()
+/* watch of command queue */
+static __thread GSource *mpd_queue_source = NULL;
+
+/* pushed commands ordered by priority */
+static __thread struct irmpc_schedule *mpd_schedule = NULL;
+
+/* whether first command was executed yet + startup time - for time-to-first-command */
+static __thread bool   mpd_first_command_done = false;
+static          gint64 mpd_start_time         = 0;
+
+/* counters of pushed/executed commands of all targets for waiting on completion */
+static unsigned int mpd_commands_pushed   = 0;
+static unsigned int mpd_commands_executed = 0;
+static GMutex       mpd_executed_mutex;
+static GCond        mpd_executed_cond;
+
+/* commands executed while next/prev or digit entry waits on a timer - complete once it is sent */
+static __thread unsigned int mpd_commands_deferred = 0;
+
+/* count commands as executed and wake up waiting thread */
+static void irmpc_mpd_executed (unsigned int count)
 {
-    /* check state and clear existing errors */
-    if (connection != NULL) {
-        if (mpd_connection_get_error (connection) == MPD_ERROR_CLOSED) {
-            irmpc_mpd_free ();
-        } else if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-            mpd_connection_clear_error (connection);
-        } else {
-            return true;
-        }
-    }
+    g_mutex_lock (&mpd_executed_mutex);
+    mpd_commands_executed += count;
+    g_cond_broadcast (&mpd_executed_cond);
+    g_mutex_unlock (&mpd_executed_mutex);
+}
 
-    if (irmpc_options.debug) {
-        printf ("INFO: trying to connect to %s:%d\n", irmpc_options.mpd_hostname, irmpc_options.mpd_port);
-    }
-    
-    /* connect */
-    connection = mpd_connection_new (irmpc_options.mpd_hostname, irmpc_options.mpd_port, 5000);
-    if (connection == NULL) return false;
+/* everything sent before was answered by mpd */
+static void irmpc_mpd_answered (gpointer data)
+{
+    irmpc_mpd_executed (GPOINTER_TO_UINT (data));
+}
 
-    if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-        fprintf (stderr, "ERROR: mpd connection failed: %s\n", mpd_connection_get_error_message (connection));
-        mpd_connection_free (connection);
-        connection = NULL;
-        return false;
-    }
+/* count commands as executed once mpd answered all commands sent for them */
+static void irmpc_mpd_completed (unsigned int count)
+{
+    if (count == 0) return;
 
-    /* password */
-    if (irmpc_options.mpd_password != NULL) {
-        if (irmpc_options.debug) {
-            printf ("INFO: sendung password: %s\n", irmpc_options.mpd_password);
-        }
-        if (! mpd_run_password (connection, irmpc_options.mpd_password)) {
-            fprintf (stderr, "ERROR: password failed\n");
-            return false;
-        }
-    }
+    irmpc_mpd_pipe_barrier (irmpc_mpd_answered, GUINT_TO_POINTER (count));
+}
 
-    if (irmpc_options.debug) {
-        printf ("INFO: connection to mpd established successfully\n");
-    }
+/* watch fd in executor main loop */
+static GSource * irmpc_mpd_watch_add (int fd, GUnixFDSourceFunc func)
+{
+    GSource *source = g_unix_fd_source_new (fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
 
-    return true;
+    g_source_set_callback (source, (GSourceFunc) func, NULL, NULL);
+    g_source_attach (source, mpd_context);
+
+    return source;
 }
 
-/* commands needing status */
-static const char * irmpc_mpd_command_status_needed[] = {
-    "playpause",
-    "delete",
-    "nextalbum",
-    "prevalbum",
-    "togglesingle",
-    "togglerandom",
-    "togglerepeat",
-    NULL
+/* remove watch from executor main loop */
+static void irmpc_mpd_watch_remove (GSource **source)
+{
+    if (*source == NULL) return;
+
+    g_source_destroy (*source);
+    g_source_unref (*source);
+    *source = NULL;
+}
+
+/* free connection and its idle watch */
+static void irmpc_mpd_connection_free ();
+
+/* events watched while connection is idle */
+#define IRMPC_MPD_IDLE_STATUS (MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_OPTIONS | MPD_IDLE_QUEUE)
+#define IRMPC_MPD_IDLE_MASK   (IRMPC_MPD_IDLE_STATUS | MPD_IDLE_STORED_PLAYLIST)
+
+/* partition both connections are in - NULL: default partition */
+static __thread gchar *partition_current = NULL;
+
+/* timeouts for connecting to active host, standby hosts + keepalive round trips */
+#define IRMPC_MPD_TIMEOUT_MS           5000
+#define IRMPC_MPD_STANDBY_TIMEOUT_MS   1000
+#define IRMPC_MPD_KEEPALIVE_TIMEOUT_MS 1000
+
+/* host of connection + ready connection to next reachable host for switching over */
+static __thread gchar                 *connection_host  = NULL;
+static __thread struct mpd_connection *standby          = NULL;
+static __thread gchar                 *standby_host     = NULL;
+static __thread GSource               *keepalive_source = NULL;
+
+/* standby hosts are checked + connected on a probe thread - executor keeps handling keys */
+struct irmpc_mpd_probe {
+    GThread                     *thread;
+    GMainContext                *context;
+    gchar                       *hosts;       /* comma separated hosts to try                 */
+    gchar                       *active;      /* host of active connection - skipped          */
+    struct mpd_connection       *connection;  /* standby to check on start, standby on return */
+    gchar                       *host;        /* host of connection                           */
+    unsigned int                 generation;
+    const struct _irmpc_options *options;     /* snapshot used by probe thread                */
 };
 
-/* handle simple mpd commands */
-void irmpc_mpd_command (const char *command)
+static __thread struct irmpc_mpd_probe *standby_probe      = NULL;
+/* bumped when standby is dropped - results of probes started before are discarded */
+static __thread unsigned int            standby_generation = 0;
+
+/* idle state of connection + event source watching its fd */
+static __thread bool     connection_idle        = false;
+static __thread GSource *connection_idle_source = NULL;
+
+/* copy of mpd status kept current by idle events */
+struct irmpc_mpd_status {
+    bool           valid;
+    /* changed on server while own commands were in flight - refresh when done */
+    bool           dirty;
+    enum mpd_state state;
+    int            volume;
+    bool           repeat;
+    bool           random;
+    bool           single;
+    unsigned int   queue_length;
+    unsigned int   queue_version;
+    int            song_pos;
+    int            song_id;
+};
+
+static __thread struct irmpc_mpd_status status_cache = {.valid = false};
+
+/* status flags for input thread resolving toggles across targets */
+static void irmpc_mpd_target_publish ()
 {
-    bool success = false;
-    int  tries   = 0;
-    bool need_status = false;
+    gint flags = 0;
 
-    /* commands needing status */
-    for (const char **i_needs_stat = irmpc_mpd_command_status_needed; *i_needs_stat != NULL; i_needs_stat++) {
-        if (strcmp (command, *i_needs_stat) == 0) {
-            need_status = true;
-            break;
-        }
+    if (status_cache.valid) {
+        if (status_cache.state == MPD_STATE_PLAY) flags |= IRMPC_MPD_TARGET_PLAYING;
+        if (status_cache.repeat)                  flags |= IRMPC_MPD_TARGET_REPEAT;
+        if (status_cache.single)                  flags |= IRMPC_MPD_TARGET_SINGLE;
+        if (status_cache.random)                  flags |= IRMPC_MPD_TARGET_RANDOM;
     }
 
-    while ((!success) && (tries < irmpc_options.mpd_maxtries)) {
-        tries++;
+    g_atomic_int_set (&(mpd_target->flags), flags);
+}
 
-        if (! irmpc_connection_check ()) continue;
+/* read status from server into cache - connection must not be idle */
+static bool irmpc_mpd_status_fetch ()
+{
+    struct mpd_status *status = mpd_run_status (connection);
+
+    if (status == NULL) {
+        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+            fprintf (stderr, "ERROR obtaining mpd status: %s\n", mpd_connection_get_error_message (connection));
+        } else {
+            fprintf (stderr, "ERROR obtaining mpd status:\n");
+        }
+        status_cache.valid = false;
+        irmpc_mpd_queue_invalidate ();
+        return false;
+    }
 
-        struct mpd_status *status = NULL;
-        /* get status if needed */
+    status_cache.valid         = true;
+    status_cache.dirty         = false;
+    status_cache.state         = mpd_status_get_state (status);
+    status_cache.volume        = mpd_status_get_volume (status);
+    status_cache.repeat        = mpd_status_get_repeat (status);
+    status_cache.random        = mpd_status_get_random (status);
+    status_cache.single        = mpd_status_get_single (status);
+    status_cache.queue_length  = mpd_status_get_queue_length (status);
+    status_cache.queue_version = mpd_status_get_queue_version (status);
+    status_cache.song_pos      = mpd_status_get_song_pos (status);
+    status_cache.song_id       = mpd_status_get_song_id (status);
 
-        if (need_status) {
-            status = mpd_run_status (connection);
+    mpd_status_free (status);
 
-            if (status == NULL) {
-                if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-                    fprintf (stderr, "ERROR obtaining mpd status: %s\n", mpd_connection_get_error_message (connection));
-                } else {
-                    fprintf (stderr, "ERROR obtaining mpd status:\n");
-                }
-                continue;
-            }
-        }
+    if (irmpc_options.debug) {
+        printf ("INFO: status cache updated - state: %d, volume: %d, song pos: %d, queue length: %u\n",
+                status_cache.state, status_cache.volume, status_cache.song_pos, status_cache.queue_length);
+    }
 
-        if (strcmp (command, "playpause") == 0) {
-            /* toggle play/pause */
-            if (mpd_status_get_state (status) == MPD_STATE_PLAY) {
-                /* pause */
-                success = mpd_run_pause (connection, true);
-            } else {
-                /* play */
-                success = mpd_run_play (connection);
-            }
-        } else if (strcmp (command, "next") == 0) {
-            success = mpd_run_next (connection);
-        } else if (strcmp (command, "prev") == 0) {
-            success = mpd_run_previous (connection);
-        } else if (strcmp (command, "stop") == 0) {
-            success = mpd_run_stop (connection);
-        } else if (strcmp (command, "delete") == 0) {
-            if ((mpd_status_get_state (status) == MPD_STATE_PLAY) || (mpd_status_get_state (status) == MPD_STATE_PAUSE)) {
-                int songpos = mpd_status_get_song_pos (status);
+    /* keep queue mirror at same version */
+    irmpc_mpd_queue_sync (connection, status_cache.queue_version, status_cache.queue_length);
 
-                if (irmpc_options.debug) {
-                    printf ("deleting song at songpos: %d\n", songpos+1);
-                }
+    irmpc_mpd_target_publish ();
 
-                success = mpd_run_delete (connection, songpos);
-            } else {
-                success = true;
-            }
-        } else if (strcmp (command, "playlistupdate") == 0) {
-            irmpc_mpd_playlist_update ();
-            success = true;
-        } else if ((strcmp (command, "nextplaylist") == 0)) {
-            irmpc_mpd_playlist_nextprev (1);
-            success = true;
-        } else if ((strcmp (command, "prevplaylist") == 0)) {
-            irmpc_mpd_playlist_nextprev (-1);
-            success = true;
-        } else if ((strcmp (command, "repeat") == 0) || (strcmp (command, "repeatoff") == 0) || (strcmp (command, "togglerepeat") == 0)) {
-            bool set = true;
-            if (strcmp (command, "repeatoff") == 0) {
-                set = false;
-            } else if (strcmp (command, "repeat") == 0) {
-                set = true;
-            } else {
-                set = !mpd_status_get_repeat (status);
-            }
-            success = mpd_run_repeat (connection, set);
-        } else if ((strcmp (command, "single") == 0) || (strcmp (command, "singleoff") == 0) || (strcmp (command, "togglesingle") == 0)) {
-            bool set = true;
-            if (strcmp (command, "singleoff") == 0) {
-                set = false;
-            } else if (strcmp (command, "single") == 0) {
-                set = true;
-            } else {
-                set = !mpd_status_get_single (status);
-            }
-            success = mpd_run_single (connection, set);
-        } else if ((strcmp (command, "random") == 0) || (strcmp (command, "randomoff") == 0) || (strcmp (command, "togglerandom") == 0)) {
-            bool set = true;
-            if (strcmp (command, "randomoff") == 0) {
-                set = false;
-            } else if (strcmp (command, "random") == 0) {
-                set = true;
-            } else {
-                set = !mpd_status_get_random (status);
-            }
-            success = mpd_run_random (connection, set);
-        } else if ((strcmp (command, "nextalbum") == 0) || (strcmp (command, "prevalbum") == 0)) {
-            int queuelen = mpd_status_get_queue_length (status);
-            int songpos  = mpd_status_get_song_pos (status);
-
-            int searchdir = ((strcmp (command, "nextalbum") == 0) ? 1 : -1);
-            if (searchdir < 0) songpos--;
-
-            if ((queuelen > 0) && (songpos >= 0)) {
-                struct mpd_song *current_song = mpd_run_get_queue_song_pos (connection, songpos);
-
-                if (current_song != NULL) {
-                    const char *current_album = mpd_song_get_tag (current_song, MPD_TAG_ALBUM, 0);
-
-                    if (irmpc_options.debug) {
-                        printf ("INFO: song pos: %d - current album: %s, queue length: %d, search direction: %d\n", songpos, current_album, queuelen, searchdir);
-                    }
-
-                    int next_songpos;
-                    bool album_found = false;
-
-                    for (next_songpos = songpos; (next_songpos >= 0) && (next_songpos < queuelen); next_songpos += searchdir) {
-                        struct mpd_song *this_song = mpd_run_get_queue_song_pos (connection, next_songpos);
-                        if (this_song == NULL) continue;
-                        const char *this_album = mpd_song_get_tag (this_song, MPD_TAG_ALBUM, 0);
-
-                        if ((this_album == NULL) || (current_album == NULL)) {
-                            /* one with album tag and one without -> "found" */
-                            album_found = true;
-                        } else {
-                            if (strcmp (this_album, current_album) != 0) {
-                                album_found = true;
-                            }
-                        }
-
-                        if (irmpc_options.debug) {
-                            printf ("INFO: song pos: %d - album: %s - found: %d\n", next_songpos, this_album, album_found);
-                        }
-
-                        mpd_song_free (this_song);
-                        if (album_found) break;
-                    }
-
-                    mpd_song_free (current_song);
-
-                    if (searchdir < 0) {
-                        if (!album_found) {
-                            album_found  = true;
-                            next_songpos = 0;
-                        } else {
-                            next_songpos++;
-                        }
-                    }
-
-                    if (irmpc_options.debug) {
-                        printf ("INFO: target found: %d, target song pos: %d\n", album_found, next_songpos);
-                    }
-
-                    if (album_found) {
-                        success = mpd_run_play_pos (connection, next_songpos);
-                    } else {
-                        success = true;
-                    }
-                }
-            } else {
-                success = true;
+    return true;
+}
+
+/* handle events reported by mpd idle */
+static void irmpc_mpd_idle_events (enum mpd_idle events)
+{
+    if (irmpc_options.debug) {
+        for (unsigned int event = 1; event <= IRMPC_MPD_IDLE_MASK; event <<= 1) {
+            if (events & event) {
+                printf ("INFO: mpd idle event: %s\n", mpd_idle_name (event));
             }
-        } else {
-            fprintf (stderr, "WARNING: ignoring command \"m:%s\" - unknown.\n", command);
-            success = true;
         }
+    }
 
-        if (status != NULL) {
-            mpd_status_free (status);
-        }
+    if ((events & MPD_IDLE_STORED_PLAYLIST) && irmpc_options.mpd_autoplaylists) {
+        irmpc_mpd_playlists_sync (connection);
+    }
+
+    if (!(events & IRMPC_MPD_IDLE_STATUS)) return;
+
+    /* status read now might not yet include own pipelined commands */
+    if (irmpc_mpd_pipe_pending () > 0) {
+        status_cache.dirty = true;
+    } else {
+        irmpc_mpd_status_fetch ();
     }
 }
 
-/* name of currently loaded playlist */
-static const char *playlist_current_name = NULL;
+static void irmpc_mpd_idle_enter ();
 
-/* load given playlist */
-static void irmpc_mpd_playlist (const struct playlist_info *playlist)
+/* connection readable while idle: receive events and go idle again */
+static gboolean irmpc_mpd_idle_input (gint fd, GIOCondition condition, gpointer data)
 {
-    bool success = false;
-    int  tries   = 0;
-    while ((!success) && (tries < irmpc_options.mpd_maxtries)) {
-        tries++;
+    irmpc_mpd_watch_remove (&connection_idle_source);
+    connection_idle = false;
 
-        if (! irmpc_connection_check ()) continue;
+    enum mpd_idle events = mpd_recv_idle (connection, false);
 
-        success = mpd_run_stop (connection);
-        if (!success) continue;
+    if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+        fprintf (stderr, "ERROR: mpd idle failed: %s\n", mpd_connection_get_error_message (connection));
+        irmpc_mpd_connection_free ();
+        return G_SOURCE_REMOVE;
+    }
 
-        success = mpd_run_clear (connection);
-        if (!success) continue;
+    irmpc_mpd_idle_events (events);
+    irmpc_mpd_idle_enter ();
 
-        success = mpd_run_load (connection, playlist->name);
-        if (!success) continue;
+    return G_SOURCE_REMOVE;
+}
 
-        success = mpd_run_random (connection, playlist->random);
-        if (!success) continue;
+/* put connection into idle mode and watch it in main loop */
+static void irmpc_mpd_idle_enter ()
+{
+    if ((connection == NULL) || connection_idle) return;
+    if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) return;
 
-        success = mpd_run_play (connection);
-        if (!success) continue;
-    }
+    if (!mpd_send_idle_mask (connection, IRMPC_MPD_IDLE_MASK)) return;
 
-    if (success) {
-        playlist_current_name = playlist->name;
-    } else {
-        playlist_current_name = NULL;
-    }
+    connection_idle        = true;
+    connection_idle_source = irmpc_mpd_watch_add (mpd_connection_get_fd (connection), irmpc_mpd_idle_input);
 }
 
-/* load next/prev playlist */
-static void irmpc_mpd_playlist_nextprev (int direction)
+/* leave idle mode before sending commands */
+static void irmpc_mpd_idle_leave ()
 {
-    const struct playlist_info *playlist = irmpc_playlist_nextprev (direction, playlist_current_name);
+    if (!connection_idle) return;
 
-    if (irmpc_options.debug) {
-        printf ("INFO: current playlist: %s\n", playlist_current_name);
-        printf ("INFO: next    playlist: %s\n", playlist->name);
+    irmpc_mpd_watch_remove (&connection_idle_source);
+    connection_idle = false;
+
+    enum mpd_idle events = mpd_run_noidle (connection);
+    irmpc_mpd_idle_events (events);
+}
+
+/* all pipelined commands answered: refresh status if it changed meanwhile */
+static void irmpc_mpd_status_drained ()
+{
+    if ((!status_cache.dirty) || (connection == NULL)) return;
+
+    irmpc_mpd_idle_leave ();
+    if (status_cache.dirty) {
+        irmpc_mpd_status_fetch ();
     }
+    irmpc_mpd_idle_enter ();
+}
 
-    irmpc_mpd_playlist (playlist);
+/* ordered list of hosts of target */
+static const char * irmpc_mpd_hosts ()
+{
+    return (mpd_target->hosts != NULL) ? mpd_target->hosts : irmpc_options.mpd_hostname;
 }
 
-/* timestamp for last key press */
-static int    playlist_update_last_press = -1;
-static time_t playlist_update_last_time;
+/* name of target for messages */
+static const char * irmpc_mpd_target_name ()
+{
+    return (mpd_target->name != NULL) ? mpd_target->name : irmpc_options.mpd_hostname;
+}
 
-/* update current playlist */
-static void irmpc_mpd_playlist_update ()
+/* connect to host + send password - NULL on errors */
+static struct mpd_connection * irmpc_mpd_connection_open (const char *host, unsigned int timeout_ms)
 {
-    if (playlist_current_name == NULL) return;
+    if (irmpc_options.debug) {
+        printf ("INFO: trying to connect to %s:%d\n", host, irmpc_options.mpd_port);
+    }
 
-    time_t this_time = time (NULL);
+    struct mpd_connection *result = mpd_connection_new (host, irmpc_options.mpd_port, timeout_ms);
+    if (result == NULL) return NULL;
 
-    int playlist_update_press = 1;
+    if (mpd_connection_get_error (result) != MPD_ERROR_SUCCESS) {
+        fprintf (stderr, "ERROR: mpd connection to %s failed: %s\n", host, mpd_connection_get_error_message (result));
+        mpd_connection_free (result);
+        return NULL;
+    }
 
-    if (playlist_update_last_press >= 0) {
-        double timediff = difftime (this_time, playlist_update_last_time);
+    /* password */
+    if (irmpc_options.mpd_password != NULL) {
         if (irmpc_options.debug) {
-            printf ("INFO: timediff to last press: %fs\n", timediff);
+            printf ("INFO: sendung password: %s\n", irmpc_options.mpd_password);
         }
-        if (timediff <= irmpc_options.lirc_key_timespan) {
-            playlist_update_press += playlist_update_last_press;
+        if (! mpd_run_password (result, irmpc_options.mpd_password)) {
+            fprintf (stderr, "ERROR: password failed\n");
+            mpd_connection_free (result);
+            return NULL;
         }
     }
 
-    if (playlist_update_press >= irmpc_options.mpd_update_amount) {
-        if (irmpc_options.debug) {
-            printf ("INFO: updating playlist: %s\n", playlist_current_name);
-        }
+    mpd_connection_set_timeout (result, IRMPC_MPD_TIMEOUT_MS);
+
+    return result;
+}
+
+/* one round trip on a non-idle connection */
+static bool irmpc_mpd_ping (struct mpd_connection *conn)
+{
+    return mpd_send_command (conn, "ping", NULL) && mpd_response_finish (conn);
+}
 
-        bool success = false;
-        int  tries   = 0;
-        while ((!success) && (tries < irmpc_options.mpd_maxtries)) {
-            tries++;
+static void irmpc_mpd_standby_free ()
+{
+    if (standby != NULL) {
+        mpd_connection_free (standby);
+        standby = NULL;
+    }
 
-            if (! irmpc_connection_check ()) continue;
+    g_free (standby_host);
+    standby_host = NULL;
 
-            success = mpd_run_save (connection, playlist_current_name);
-            if (!success) {
-                /* playlist might exist - try deleting */
-                if (irmpc_options.debug) {
-                    if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-                        fprintf (stderr, "ERROR: %s\n", mpd_connection_get_error_message (connection));
-                    }
-                    printf ("INFO: playlist %s might exist - trying to delete\n", playlist_current_name);
-                }
-                mpd_connection_clear_error (connection);
-                success = mpd_run_rm (connection, playlist_current_name);
-                if (!success) {
-                    if (irmpc_options.debug) {
-                        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-                            fprintf (stderr, "ERROR: %s\n", mpd_connection_get_error_message (connection));
-                        }
-                    }
-                    continue;
-                }
-                if (irmpc_options.debug) {
-                    printf ("INFO: second try to save playlist %s\n", playlist_current_name);
-                }
-                success = mpd_run_save (connection, playlist_current_name);
-                if (!success) continue;
+    standby_generation++;
+}
+
+static gboolean irmpc_mpd_standby_probed (gpointer data);
+
+/* probe thread: ping given standby, connect to first reachable host other than active one if there is none */
+static gpointer irmpc_mpd_standby_probe_run (gpointer data)
+{
+    struct irmpc_mpd_probe *probe = data;
+
+    irmpc_options_use (probe->options);
+
+    if ((probe->connection != NULL) && (!irmpc_mpd_ping (probe->connection))) {
+        fprintf (stderr, "ERROR: standby mpd connection to %s lost\n", probe->host);
+        mpd_connection_free (probe->connection);
+        g_free (probe->host);
+        probe->connection = NULL;
+        probe->host       = NULL;
+    }
+
+    gchar **hosts = g_strsplit (probe->hosts, ",", 0);
+
+    for (int i = 0; (probe->connection == NULL) && (hosts[i] != NULL); i++) {
+        g_strstrip (hosts[i]);
+        if ((hosts[i][0] == '\0') || (strcmp (hosts[i], probe->active) == 0)) continue;
+
+        probe->connection = irmpc_mpd_connection_open (hosts[i], IRMPC_MPD_STANDBY_TIMEOUT_MS);
+        if (probe->connection != NULL) {
+            probe->host = g_strdup (hosts[i]);
+            if (irmpc_options.verbose) {
+                printf ("INFO: standby connection to mpd at %s ready\n", probe->host);
             }
         }
+    }
+
+    g_strfreev (hosts);
+
+    irmpc_options_use (NULL);
+    g_main_context_invoke (probe->context, irmpc_mpd_standby_probed, probe);
+
+    return NULL;
+}
 
-        playlist_update_press = 0;
+/* probe finished (executor thread): keep its connection as standby unless it got outdated meanwhile */
+static gboolean irmpc_mpd_standby_probed (gpointer data)
+{
+    struct irmpc_mpd_probe *probe = data;
+
+    g_thread_join (probe->thread);
+    standby_probe = NULL;
+
+    if ((probe->connection != NULL) && (probe->generation == standby_generation) && (connection_host != NULL) &&
+        (strcmp (probe->host, connection_host) != 0)) {
+        standby      = probe->connection;
+        standby_host = probe->host;
+    } else {
+        if (probe->connection != NULL) mpd_connection_free (probe->connection);
+        g_free (probe->host);
     }
 
-    playlist_update_last_press = playlist_update_press;
-    playlist_update_last_time  = time (NULL);
+    irmpc_options_unref (probe->options);
+    g_free (probe->hosts);
+    g_free (probe->active);
+    g_free (probe);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* keep connection to first reachable host other than active one - checked on probe thread */
+static void irmpc_mpd_standby_check ()
+{
+    if ((standby_probe != NULL) || (connection == NULL)) return;
+
+    struct irmpc_mpd_probe *probe = g_new0 (struct irmpc_mpd_probe, 1);
+
+    probe->context    = mpd_context;
+    probe->hosts      = g_strdup (irmpc_mpd_hosts ());
+    probe->active     = g_strdup (connection_host);
+    probe->generation = standby_generation;
+    probe->options    = irmpc_options_ref (&irmpc_options);
+
+    /* standby is owned by probe until it returns */
+    probe->connection = standby;
+    probe->host       = standby_host;
+    standby           = NULL;
+    standby_host      = NULL;
+
+    standby_probe = probe;
+    probe->thread = g_thread_new ("irmpc-standby", irmpc_mpd_standby_probe_run, probe);
 }
 
-/* last number entered + timestamp for multi-digit numbers */
-static int    playlist_num_last = -1;
-static time_t playlist_num_last_time;
+/* wait for running probe at shutdown - its result is discarded */
+static void irmpc_mpd_standby_probe_wait ()
+{
+    standby_generation++;
+
+    while (standby_probe != NULL) {
+        g_main_context_iteration (mpd_context, true);
+    }
+}
 
-/* handle number key presses for playlist loading */
-void irmpc_mpd_playlist_key (int key)
+/* take standby connection if still alive - else connect to first reachable host */
+static bool irmpc_mpd_connection_failover ()
 {
-    time_t this_time = time (NULL);
+    if ((standby != NULL) && irmpc_mpd_ping (standby)) {
+        connection      = standby;
+        connection_host = standby_host;
+        standby         = NULL;
+        standby_host    = NULL;
+
+        if (irmpc_options.verbose) {
+            printf ("INFO: switched over to mpd at %s\n", connection_host);
+        }
+        return true;
+    }
+    irmpc_mpd_standby_free ();
 
-    if ((key < 0) || (key > 9)) return;
+    gchar **hosts = g_strsplit (irmpc_mpd_hosts (), ",", 0);
 
-    unsigned int number = key;
+    for (int i = 0; (connection == NULL) && (hosts[i] != NULL); i++) {
+        g_strstrip (hosts[i]);
+        if (hosts[i][0] == '\0') continue;
 
-    if (playlist_num_last > 0) {
-        double timediff = difftime (this_time, playlist_num_last_time);
-        if (irmpc_options.debug) {
-            printf ("INFO: timediff to last key: %fs\n", timediff);
+        connection = irmpc_mpd_connection_open (hosts[i], IRMPC_MPD_TIMEOUT_MS);
+        if (connection != NULL) {
+            connection_host = g_strdup (hosts[i]);
         }
-        if (timediff <= irmpc_options.lirc_key_timespan) {
-            number = playlist_num_last * 10 + number;
+    }
+
+    g_strfreev (hosts);
+
+    return (connection != NULL);
+}
+
+/* check whether connection is working - try (re)connecting if not */
+static bool irmpc_connection_check ()
+{
+    irmpc_mpd_idle_leave ();
+
+    /* check state and clear existing errors */
+    if (connection != NULL) {
+        if (mpd_connection_get_error (connection) == MPD_ERROR_CLOSED) {
+            irmpc_mpd_connection_free ();
+        } else if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+            mpd_connection_clear_error (connection);
+        } else {
+            return true;
         }
     }
 
-    const struct playlist_info * playlist = irmpc_playlist_get (number);
+    if (!irmpc_mpd_connection_failover ()) return false;
+
+    /* partition */
+    if ((partition_current != NULL) && (! mpd_run_switch_partition (connection, partition_current))) {
+        fprintf (stderr, "ERROR: switching to partition %s failed\n", partition_current);
+        mpd_connection_clear_error (connection);
+    }
+
     if (irmpc_options.debug) {
-        printf ("number chosen: %d\n", number);
+        printf ("INFO: connection to mpd established successfully\n");
     }
 
-    if (playlist != NULL) {
-        if (irmpc_options.debug) {
-            printf ("playlist: %s - random: %d\n", playlist->name, playlist->random);
-        }
+    /* commands follow to same host */
+    irmpc_mpd_pipe_set_host (connection_host);
 
-        irmpc_mpd_playlist (playlist);
+    irmpc_mpd_status_fetch ();
+
+    if (irmpc_options.mpd_autoplaylists) {
+        irmpc_mpd_playlists_sync (connection);
     }
 
-    playlist_num_last = number;
-    playlist_num_last_time = time (NULL);
+    return true;
 }
 
-/* last volume setting for volume/mute */
-static bool last_mute   = false;
-static int  last_volume = 100;
-
-/* volume/mute commands */
-void irmpc_mpd_volume (const char *command)
+/* obtain current status from cache - reading it from server only if not available */
+static struct irmpc_mpd_status * irmpc_mpd_status ()
 {
-    bool success = false;
-    int  tries   = 0;
-    while ((!success) && (tries < irmpc_options.mpd_maxtries)) {
+    if (status_cache.valid) return &status_cache;
+
+    int tries = 0;
+    while (tries < irmpc_options.mpd_maxtries) {
         tries++;
 
         if (! irmpc_connection_check ()) continue;
 
-        struct mpd_status *status = mpd_run_status (connection);
+        if (status_cache.valid || irmpc_mpd_status_fetch ()) return &status_cache;
+    }
 
-        if (status == NULL) {
-            if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-                fprintf (stderr, "ERROR obtaining mpd status: %s\n", mpd_connection_get_error_message (connection));
-            } else {
-                fprintf (stderr, "ERROR obtaining mpd status:\n");
-            }
-            continue;
-        }
+    return NULL;
+}
 
-        int  current_volume = mpd_status_get_volume (status);
-        bool current_mute;
+/* make sure queue mirror matches status - syncing it if not */
+static bool irmpc_mpd_queue_current (struct irmpc_mpd_status *status)
+{
+    if (irmpc_mpd_queue_valid (status->queue_version)) return true;
 
-        mpd_status_free (status);
+    if (!irmpc_connection_check ()) return false;
 
-        if (strcmp (command, "up") == 0) {
-            current_mute = false;
-            if (last_mute) {
-                current_volume = last_volume;
-            } else {
-                current_volume += irmpc_options.volume_step;
-            }
-        } else if (strcmp (command, "down") == 0) {
-            if (last_mute) {
-                current_mute   = true;
-                current_volume = last_volume;
-            } else {
-                current_mute    = false;
-                current_volume -= irmpc_options.volume_step;
-            }
-        } else if (strcmp (command, "mute") == 0) {
-            if (last_mute) {
-                current_mute   = false;
-                current_volume = last_volume;
-            } else {
-                current_mute = true;
-            }
-        } else {
-            fprintf (stderr, "WARNING: ignoring command \"v:%s\" - unknown.\n", command);
-            break;
-        }
+    return irmpc_mpd_queue_sync (connection, status->queue_version, status->queue_length);
+}
 
-        if (current_volume < 0)   current_volume = 0;
-        if (current_volume > 100) current_volume = 100;
+/* play first song of album relative to current one using album index of queue mirror:
+ *  0: start of current album
+ * >0: start of n-th next album
+ * <0: like prev for songs - start of album before current song, further n-1 albums back */
+static void irmpc_mpd_album_jump (struct irmpc_mpd_status *status, long int albums)
+{
+    if (!irmpc_mpd_queue_current (status)) return;
 
-        if (irmpc_options.debug) {
-            printf ("INFO: setting volume from %d (mute: %d) to %d (mute: %d)\n", last_volume, last_mute, current_volume, current_mute);
-        }
+    int queuelen = irmpc_mpd_queue_length ();
+    int songpos  = status->song_pos;
 
-        if (current_mute) {
-            success = mpd_run_set_volume (connection, 0);
-            if (!success) continue;
-        } else {
-            success = mpd_run_set_volume (connection, current_volume);
-            if (!success) continue;
-        }
+    if (albums < 0) songpos--;
 
-        last_mute   = current_mute;
-        last_volume = current_volume;
+    if ((queuelen <= 0) || (songpos < 0) || (songpos >= queuelen)) return;
+
+    long int album = irmpc_mpd_queue_album_of (songpos);
+
+    if (albums < 0) {
+        album += albums + 1;
+        if (album < 0) album = 0;
+    } else {
+        album += albums;
+        /* no album after last one */
+        if (album >= irmpc_mpd_queue_album_count ()) return;
     }
-}
 
+    unsigned int target = irmpc_mpd_queue_album_start (album);
 
-/* free connection struct */
-void irmpc_mpd_free () {
-    if (connection != NULL) {
-        mpd_connection_free (connection);
-        connection = NULL;
+    if (irmpc_options.debug) {
+        printf ("INFO: song pos: %d - album jump by %ld to album %ld at song pos: %u\n", status->song_pos, albums, album, target);
     }
+
+    char songpos_str [16];
+    snprintf (songpos_str, sizeof (songpos_str), "%u", target);
+    irmpc_mpd_pipe_send (NULL, NULL, "play", songpos_str, NULL);
+
+    status->state    = MPD_STATE_PLAY;
+    status->song_pos = target;
 }
 
+/* next/prev presses waiting to be folded into one jump + timer sending them */
+static __thread int      skip_pending = 0;
+static __thread GSource *skip_source  = NULL;
+
+/* send folded next/prev presses as one jump */
+static void irmpc_mpd_skip_flush ()
+{
+    irmpc_mpd_watch_remove (&skip_source);
+
+    int skip     = skip_pending;
+    skip_pending = 0;
+
+    if (skip == 0) return;
+
+    struct irmpc_mpd_status *status = irmpc_mpd_status ();
+    if (status == NULL) return;
+
+    /* nothing to skip when stopped - same as mpd */
+    if ((status->state != MPD_STATE_PLAY) && (status->state != MPD_STATE_PAUSE)) return;
+
+    if (status->random) {
+        /* song order unknown: pipeline single next/previous commands */
+        for (int i = abs (skip); i > 0; i--) {
+            irmpc_mpd_pipe_send (NULL, NULL, (skip > 0 ? "next" : "previous"), NULL);
+        }
+        return;
+    }
+
+    long int target = (long int) status->song_pos + skip;
+    long int length = status->queue_length;
+
+    if (status->repeat && (length > 0)) {
+        target %= length;
+        if (target < 0) target += length;
+    } else if (target < 0) {
+        target = 0;
+    } else if (target >= length) {
+        /* skipped past last song */
+        irmpc_mpd_pipe_send (NULL, NULL, "stop", NULL);
+        status->state = MPD_STATE_STOP;
+        return;
+    }
+
+    if (irmpc_options.debug) {
+        printf ("INFO: song pos: %d - skipping %d songs to song pos: %ld\n", status->song_pos, skip, target);
+    }
+
+    char songpos_str [16];
+    snprintf (songpos_str, sizeof (songpos_str), "%ld", target);
+    irmpc_mpd_pipe_send (NULL, NULL, "play", songpos_str, NULL);
+
+    status->state    = MPD_STATE_PLAY;
+    status->song_pos = target;
+}
+
+static void irmpc_mpd_deferred_release ();
+
+/* no further next/prev within window: send jump */
+static gboolean irmpc_mpd_skip_timeout (gpointer data)
+{
+    irmpc_mpd_skip_flush ();
+    irmpc_mpd_deferred_release ();
+    irmpc_mpd_idle_enter ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* next/prev press: first one is sent at once, further presses within skip window are folded */
+static void irmpc_mpd_skip (int direction)
+{
+    if (irmpc_options.lirc_skip_window == 0) {
+        irmpc_mpd_pipe_send (NULL, NULL, (direction > 0 ? "next" : "previous"), NULL);
+        return;
+    }
+
+    skip_pending += direction;
+
+    if (skip_source == NULL) {
+        /* no window open: jump right away, open window for following presses */
+        irmpc_mpd_skip_flush ();
+    }
+
+    irmpc_mpd_watch_remove (&skip_source);
+    skip_source = g_timeout_source_new (irmpc_options.lirc_skip_window);
+    g_source_set_callback (skip_source, irmpc_mpd_skip_timeout, NULL, NULL);
+    g_source_attach (skip_source, mpd_context);
+}
+
+/* commands needing status */
+static const bool irmpc_mpd_command_status_needed [IRMPC_OP_COUNT] = {
+    [IRMPC_OP_PLAYPAUSE]    = true,
+    [IRMPC_OP_DELETE]       = true,
+    [IRMPC_OP_NEXTALBUM]    = true,
+    [IRMPC_OP_PREVALBUM]    = true,
+    [IRMPC_OP_ALBUMSTART]   = true,
+    [IRMPC_OP_ALBUMSKIP]    = true,
+    [IRMPC_OP_TOGGLESINGLE] = true,
+    [IRMPC_OP_TOGGLERANDOM] = true,
+    [IRMPC_OP_TOGGLEREPEAT] = true
+};
+
+/* handle simple mpd commands */
+static void irmpc_mpd_command (const struct irmpc_command *command)
+{
+    struct irmpc_mpd_status *status = NULL;
+
+    /* get status if needed */
+    if (irmpc_mpd_command_status_needed[command->op]) {
+        status = irmpc_mpd_status ();
+        if (status == NULL) return;
+    }
+
+    bool set = true;
+
+    switch (command->op) {
+        case IRMPC_OP_PLAYPAUSE:
+            set = (status->state != MPD_STATE_PLAY);
+            /* fall through */
+        case IRMPC_OP_PLAY:
+        case IRMPC_OP_PAUSE:
+            if (command->op == IRMPC_OP_PAUSE) set = false;
+            if (set) {
+                irmpc_mpd_pipe_send (NULL, NULL, "play", NULL);
+            } else {
+                irmpc_mpd_pipe_send (NULL, NULL, "pause", "1", NULL);
+            }
+            if (status_cache.valid) status_cache.state = (set ? MPD_STATE_PLAY : MPD_STATE_PAUSE);
+            break;
+        case IRMPC_OP_NEXT:
+            irmpc_mpd_skip (1);
+            break;
+        case IRMPC_OP_PREV:
+            irmpc_mpd_skip (-1);
+            break;
+        case IRMPC_OP_STOP:
+            irmpc_mpd_pipe_send (NULL, NULL, "stop", NULL);
+            break;
+        case IRMPC_OP_DELETE:
+            if ((status->state == MPD_STATE_PLAY) || (status->state == MPD_STATE_PAUSE)) {
+                int songpos = status->song_pos;
+
+                if (irmpc_options.debug) {
+                    printf ("deleting song at songpos: %d\n", songpos+1);
+                }
+
+                char songpos_str [16];
+                snprintf (songpos_str, sizeof (songpos_str), "%d", songpos);
+                irmpc_mpd_pipe_send (NULL, NULL, "delete", songpos_str, NULL);
+                status->queue_length--;
+                irmpc_mpd_queue_delete (songpos);
+            }
+            break;
+        case IRMPC_OP_PLAYLISTUPDATE:
+            irmpc_mpd_playlist_update (command);
+            break;
+        case IRMPC_OP_NEXTPLAYLIST:
+            irmpc_mpd_playlist_nextprev (1);
+            break;
+        case IRMPC_OP_PREVPLAYLIST:
+            irmpc_mpd_playlist_nextprev (-1);
+            break;
+        case IRMPC_OP_TOGGLEREPEAT:
+            set = !status->repeat;
+            /* fall through */
+        case IRMPC_OP_REPEAT:
+        case IRMPC_OP_REPEATOFF:
+            if (command->op == IRMPC_OP_REPEATOFF) set = false;
+            irmpc_mpd_pipe_send (NULL, NULL, "repeat", (set ? "1" : "0"), NULL);
+            if (status_cache.valid) status_cache.repeat = set;
+            break;
+        case IRMPC_OP_TOGGLESINGLE:
+            set = !status->single;
+            /* fall through */
+        case IRMPC_OP_SINGLE:
+        case IRMPC_OP_SINGLEOFF:
+            if (command->op == IRMPC_OP_SINGLEOFF) set = false;
+            irmpc_mpd_pipe_send (NULL, NULL, "single", (set ? "1" : "0"), NULL);
+            if (status_cache.valid) status_cache.single = set;
+            break;
+        case IRMPC_OP_TOGGLERANDOM:
+            set = !status->random;
+            /* fall through */
+        case IRMPC_OP_RANDOM:
+        case IRMPC_OP_RANDOMOFF:
+            if (command->op == IRMPC_OP_RANDOMOFF) set = false;
+            irmpc_mpd_pipe_send (NULL, NULL, "random", (set ? "1" : "0"), NULL);
+            if (status_cache.valid) status_cache.random = set;
+            break;
+        case IRMPC_OP_NEXTALBUM:
+            irmpc_mpd_album_jump (status, 1);
+            break;
+        case IRMPC_OP_PREVALBUM:
+            irmpc_mpd_album_jump (status, -1);
+            break;
+        case IRMPC_OP_ALBUMSTART:
+            irmpc_mpd_album_jump (status, 0);
+            break;
+        case IRMPC_OP_ALBUMSKIP:
+            irmpc_mpd_album_jump (status, command->number);
+            break;
+        default:
+            fprintf (stderr, "WARNING: ignoring command \"m:%s\" - unknown.\n", command->arg);
+            break;
+    }
+}
+
+/* name of currently loaded playlist */
+static __thread const char *playlist_current_name = NULL;
+
+/* response to playlist switch: forget current playlist if switching failed */
+static void irmpc_mpd_playlist_loaded (bool success, unsigned int done, gpointer data)
+{
+    if ((!success) && (playlist_current_name == data)) {
+        playlist_current_name = NULL;
+    }
+}
+
+/* load given playlist into current partition - one command list, resumed at failed command on retry */
+static void irmpc_mpd_playlist_load (const struct playlist_info *playlist)
+{
+    struct irmpc_mpd_pipe_request *request = irmpc_mpd_pipe_list_new (irmpc_mpd_playlist_loaded, (gpointer) playlist->name);
+
+    irmpc_mpd_pipe_list_add (request, "stop",  NULL);
+    irmpc_mpd_pipe_list_add (request, "clear", NULL);
+    irmpc_mpd_pipe_list_add (request, "load",  playlist->name, NULL);
+    irmpc_mpd_pipe_list_add (request, "random", (playlist->random ? "1" : "0"), NULL);
+    irmpc_mpd_pipe_list_add (request, "play",  NULL);
+
+    irmpc_mpd_pipe_list_send (request);
+}
+
+/* playlist kept loaded in its own partition */
+struct irmpc_mpd_partition {
+    const char *playlist_name;
+    char        name [32];
+};
+
+/* partition names: prefix of this run + serial shared by all targets - never the same for two playlists */
+#define IRMPC_MPD_PARTITION_PREFIX "irmpc-"
+static guint32 partition_nonce  = 0;
+static gint    partition_serial = 0;
+
+/* resident partitions, most recently used first */
+static __thread GQueue     partition_lru      = G_QUEUE_INIT;
+/* audio outputs moved to the partition switched to */
+static __thread GPtrArray *partition_outputs  = NULL;
+/* partition mode usable: -1 not checked yet */
+static __thread int        partition_support  = -1;
+
+/* remove partitions left by earlier runs - fails quietly for ones still in use */
+static void irmpc_mpd_partition_cleanup ()
+{
+    gchar     *own       = g_strdup_printf (IRMPC_MPD_PARTITION_PREFIX "%08x-", partition_nonce);
+    GPtrArray *leftovers = g_ptr_array_new_with_free_func (g_free);
+
+    if (mpd_send_listpartitions (connection)) {
+        struct mpd_pair *pair;
+        while ((pair = mpd_recv_partition_pair (connection)) != NULL) {
+            if (g_str_has_prefix (pair->value, IRMPC_MPD_PARTITION_PREFIX) && (!g_str_has_prefix (pair->value, own))) {
+                g_ptr_array_add (leftovers, g_strdup (pair->value));
+            }
+            mpd_return_pair (connection, pair);
+        }
+    }
+
+    if (!mpd_response_finish (connection)) {
+        mpd_connection_clear_error (connection);
+    }
+
+    for (unsigned int i = 0; i < leftovers->len; i++) {
+        if (irmpc_options.debug) {
+            printf ("INFO: removing partition %s of earlier run\n", (const char *) g_ptr_array_index (leftovers, i));
+        }
+        irmpc_mpd_pipe_send_flags (IRMPC_MPD_PIPE_QUIET, NULL, NULL, "delpartition", g_ptr_array_index (leftovers, i), NULL);
+    }
+
+    g_ptr_array_free (leftovers, true);
+    g_free (own);
+}
+
+/* check server version and remember audio outputs to move between partitions */
+static bool irmpc_mpd_partition_check ()
+{
+    if (partition_support >= 0) return partition_support;
+    if (!irmpc_connection_check ()) return false;
+
+    if (mpd_connection_cmp_server_version (connection, 0, 22, 0) < 0) {
+        fprintf (stderr, "WARNING: mpd does not support partitions - loading playlists directly\n");
+        partition_support = false;
+        return false;
+    }
+
+    partition_outputs = g_ptr_array_new_with_free_func (g_free);
+
+    if (mpd_send_outputs (connection)) {
+        struct mpd_output *output;
+        while ((output = mpd_recv_output (connection)) != NULL) {
+            if (mpd_output_get_enabled (output)) {
+                g_ptr_array_add (partition_outputs, g_strdup (mpd_output_get_name (output)));
+            }
+            mpd_output_free (output);
+        }
+    }
+
+    if ((!mpd_response_finish (connection)) || (partition_outputs->len == 0)) {
+        fprintf (stderr, "WARNING: no audio outputs found - loading playlists directly\n");
+        mpd_connection_clear_error (connection);
+        g_ptr_array_free (partition_outputs, true);
+        partition_outputs = NULL;
+        partition_support = false;
+        return false;
+    }
+
+    irmpc_mpd_partition_cleanup ();
+
+    partition_support = true;
+    return true;
+}
+
+/* find resident partition of playlist */
+static struct irmpc_mpd_partition * irmpc_mpd_partition_find (const char *playlist_name)
+{
+    for (GList *item = partition_lru.head; item != NULL; item = item->next) {
+        struct irmpc_mpd_partition *partition = item->data;
+        if (strcmp (partition->playlist_name, playlist_name) == 0) return partition;
+    }
+    return NULL;
+}
+
+/* response to loading playlist into partition: forget partition if it failed */
+static void irmpc_mpd_partition_loaded (bool success, unsigned int done, gpointer data)
+{
+    if (!success) {
+        struct irmpc_mpd_partition *partition = irmpc_mpd_partition_find (data);
+        if (partition != NULL) {
+            g_queue_remove (&partition_lru, partition);
+            g_free (partition);
+        }
+    }
+    g_free (data);
+}
+
+/* partition must stay: in use (current), switched to (head of lru) or just created (keep) */
+static bool irmpc_mpd_partition_pinned (const struct irmpc_mpd_partition *partition, const struct irmpc_mpd_partition *keep)
+{
+    if ((partition == keep) || (partition == g_queue_peek_head (&partition_lru))) return true;
+
+    return ((partition_current != NULL) && (strcmp (partition->name, partition_current) == 0));
+}
+
+/* drop least recently used partitions until at most limit are resident - pinned ones are kept in place,
+ * so the lru may exceed limit until the current one is released */
+static void irmpc_mpd_partition_evict (unsigned int limit, const struct irmpc_mpd_partition *keep)
+{
+    GList *item = partition_lru.tail;
+
+    while ((item != NULL) && (g_queue_get_length (&partition_lru) > limit)) {
+        struct irmpc_mpd_partition *partition = item->data;
+        GList                      *prev      = item->prev;
+
+        if (!irmpc_mpd_partition_pinned (partition, keep)) {
+            if (irmpc_options.debug) {
+                printf ("INFO: removing partition %s of playlist %s\n", partition->name, partition->playlist_name);
+            }
+
+            irmpc_mpd_pipe_send (NULL, NULL, "delpartition", partition->name, NULL);
+            g_queue_delete_link (&partition_lru, item);
+            g_free (partition);
+        }
+
+        item = prev;
+    }
+}
+
+/* get resident partition of playlist - creating it and loading playlist into it if needed
+ * commands are sent to partition "return_to" afterwards - new partitions are not in lru yet */
+static struct irmpc_mpd_partition * irmpc_mpd_partition_get (const struct playlist_info *playlist, const char *return_to)
+{
+    struct irmpc_mpd_partition *partition = irmpc_mpd_partition_find (playlist->name);
+
+    if (partition != NULL) return partition;
+
+    partition = g_new0 (struct irmpc_mpd_partition, 1);
+    partition->playlist_name = playlist->name;
+    snprintf (partition->name, sizeof (partition->name), IRMPC_MPD_PARTITION_PREFIX "%08x-%d", partition_nonce, g_atomic_int_add (&partition_serial, 1));
+
+    if (irmpc_options.debug) {
+        printf ("INFO: loading playlist %s into partition %s\n", playlist->name, partition->name);
+    }
+
+    /* sent again after a lost connection - it may exist then, failing is expected */
+    irmpc_mpd_pipe_send_flags (IRMPC_MPD_PIPE_QUIET | IRMPC_MPD_PIPE_REPEAT, NULL, NULL, "newpartition", partition->name, NULL);
+
+    struct irmpc_mpd_pipe_request *request = irmpc_mpd_pipe_list_new (irmpc_mpd_partition_loaded, g_strdup (playlist->name));
+
+    irmpc_mpd_pipe_list_add (request, "partition", partition->name, NULL);
+    irmpc_mpd_pipe_list_add (request, "stop",   NULL);
+    irmpc_mpd_pipe_list_add (request, "clear",  NULL);
+    irmpc_mpd_pipe_list_add (request, "load",   playlist->name, NULL);
+    irmpc_mpd_pipe_list_add (request, "random", (playlist->random ? "1" : "0"), NULL);
+    irmpc_mpd_pipe_list_add (request, "partition", ((return_to != NULL) ? return_to : "default"), NULL);
+
+    irmpc_mpd_pipe_list_send (request);
+
+    return partition;
+}
+
+/* response to partition switch: move status connection to new partition */
+static void irmpc_mpd_partition_switched (bool success, unsigned int done, gpointer data)
+{
+    if (!success) {
+        g_free (data);
+        return;
+    }
+
+    g_free (partition_current);
+    partition_current = data;
+
+    irmpc_mpd_pipe_set_partition (partition_current);
+
+    /* previous partition is released now */
+    irmpc_mpd_partition_evict (irmpc_options.mpd_partitions, NULL);
+
+    if (connection == NULL) return;
+
+    irmpc_mpd_idle_leave ();
+    if (! mpd_run_switch_partition (connection, partition_current)) {
+        fprintf (stderr, "ERROR: switching to partition %s failed\n", partition_current);
+        mpd_connection_clear_error (connection);
+    }
+    irmpc_mpd_queue_invalidate ();
+    irmpc_mpd_status_fetch ();
+    irmpc_mpd_idle_enter ();
+}
+
+/* switch to partition of playlist: pause current, move outputs, play */
+static void irmpc_mpd_partition_switch (const struct playlist_info *playlist)
+{
+    struct irmpc_mpd_partition *partition = irmpc_mpd_partition_get (playlist, partition_current);
+
+    if (irmpc_options.debug) {
+        printf ("INFO: switching to partition %s of playlist %s\n", partition->name, playlist->name);
+    }
+
+    struct irmpc_mpd_pipe_request *request = irmpc_mpd_pipe_list_new (irmpc_mpd_partition_switched, g_strdup (partition->name));
+
+    irmpc_mpd_pipe_list_add (request, "pause", "1", NULL);
+    irmpc_mpd_pipe_list_add (request, "partition", partition->name, NULL);
+    for (unsigned int i = 0; i < partition_outputs->len; i++) {
+        irmpc_mpd_pipe_list_add (request, "moveoutput", g_ptr_array_index (partition_outputs, i), NULL);
+    }
+    irmpc_mpd_pipe_list_add (request, "play", NULL);
+
+    irmpc_mpd_pipe_list_send (request);
+
+    /* most recently used */
+    g_queue_remove (&partition_lru, partition);
+    g_queue_push_head (&partition_lru, partition);
+
+    irmpc_mpd_partition_evict (irmpc_options.mpd_partitions, partition);
+}
+
+/* speculatively load playlist into a partition without switching to it - keep: earlier preload to retain
+ * returns resident partition of playlist, NULL if there is no room */
+static struct irmpc_mpd_partition * irmpc_mpd_partition_preload (const struct playlist_info *playlist, const struct irmpc_mpd_partition *keep)
+{
+    if (playlist == NULL) return NULL;
+
+    struct irmpc_mpd_partition *partition = irmpc_mpd_partition_find (playlist->name);
+    if (partition != NULL) return partition;
+
+    /* keep room for the partition in use */
+    if (irmpc_options.mpd_partitions < 2) return NULL;
+
+    /* make room first - no preload if only pinned partitions are left */
+    irmpc_mpd_partition_evict (irmpc_options.mpd_partitions - 1, keep);
+    if (g_queue_get_length (&partition_lru) >= irmpc_options.mpd_partitions) return NULL;
+
+    const char *return_to = partition_current;
+    struct irmpc_mpd_partition *switched_to = g_queue_peek_head (&partition_lru);
+    if (switched_to != NULL) return_to = switched_to->name;
+
+    /* just behind the one switched to - evicted before it */
+    partition = irmpc_mpd_partition_get (playlist, return_to);
+    g_queue_push_nth (&partition_lru, partition, 1);
+
+    return partition;
+}
+
+/* free partition bookkeeping */
+static void irmpc_mpd_partition_free ()
+{
+    g_queue_clear_full (&partition_lru, g_free);
+
+    if (partition_outputs != NULL) {
+        g_ptr_array_free (partition_outputs, true);
+        partition_outputs = NULL;
+    }
+
+    g_free (partition_current);
+    partition_current = NULL;
+    partition_support = -1;
+}
+
+/* load given playlist - switching partitions if enabled */
+static void irmpc_mpd_playlist (const struct playlist_info *playlist)
+{
+    playlist_current_name = playlist->name;
+
+    if ((irmpc_options.mpd_partitions > 0) && irmpc_mpd_partition_check ()) {
+        irmpc_mpd_partition_switch (playlist);
+    } else {
+        irmpc_mpd_playlist_load (playlist);
+    }
+
+    if (status_cache.valid) {
+        status_cache.state  = MPD_STATE_PLAY;
+        status_cache.random = playlist->random;
+    }
+}
+
+/* load next/prev playlist */
+static void irmpc_mpd_playlist_nextprev (int direction)
+{
+    const struct playlist_info *playlist = irmpc_playlist_nextprev (direction, playlist_current_name);
+
+    if (playlist == NULL) return;
+
+    if (irmpc_options.debug) {
+        printf ("INFO: current playlist: %s\n", playlist_current_name);
+        printf ("INFO: next    playlist: %s\n", playlist->name);
+    }
+
+    irmpc_mpd_playlist (playlist);
+
+    /* user is browsing: have neighbours ready */
+    if ((irmpc_options.mpd_partitions > 0) && (partition_support > 0)) {
+        struct irmpc_mpd_partition *ahead = irmpc_mpd_partition_preload (irmpc_playlist_nextprev (direction, playlist->name), NULL);
+        irmpc_mpd_partition_preload (irmpc_playlist_nextprev (-direction, playlist->name), ahead);
+    }
+}
+
+/* playlist update key presses */
+static __thread struct irmpc_gesture playlist_update_gesture = IRMPC_GESTURE_INIT;
+
+/* old playlist removed (or not there): store queue under its name
+ * repeated after a lost connection - a save done already only fails, the playlist is not lost */
+static void irmpc_mpd_playlist_removed (bool success, unsigned int done, gpointer data)
+{
+    irmpc_mpd_pipe_send_flags (IRMPC_MPD_PIPE_REPEAT, NULL, NULL, "save", (const char *) data, NULL);
+    g_free (data);
+}
+
+/* update current playlist */
+static void irmpc_mpd_playlist_update (const struct irmpc_command *command)
+{
+    if (playlist_current_name == NULL) return;
+
+    unsigned int playlist_update_press = irmpc_gesture_feed (&playlist_update_gesture, command->time, command->repeat);
+
+    if ((playlist_update_press >= irmpc_options.mpd_update_amount) || irmpc_gesture_long (&playlist_update_gesture)) {
+        if (irmpc_options.debug) {
+            printf ("INFO: updating playlist: %s\n", playlist_current_name);
+        }
+
+        if ((connection != NULL) && (mpd_connection_cmp_server_version (connection, 0, 24, 0) >= 0)) {
+            irmpc_mpd_pipe_send (NULL, NULL, "save", playlist_current_name, "replace", NULL);
+        } else {
+            /* playlist might not exist - save only once rm is answered, so it is never lost in between */
+            irmpc_mpd_pipe_send_flags (IRMPC_MPD_PIPE_QUIET, irmpc_mpd_playlist_removed, g_strdup (playlist_current_name),
+                                       "rm", playlist_current_name, NULL);
+        }
+
+        irmpc_gesture_consume (&playlist_update_gesture);
+    }
+}
+
+/* digits entered so far + timer ending entry after keytimespan */
+static __thread char     playlist_digits [16] = "";
+static __thread GSource *playlist_digits_source = NULL;
+
+/* end numeric entry: load playlist matching entered digits if any */
+static void irmpc_mpd_playlist_digits_commit ()
+{
+    irmpc_mpd_watch_remove (&playlist_digits_source);
+
+    if (playlist_digits[0] == '\0') return;
+
+    const struct playlist_info *playlist = NULL;
+    irmpc_playlist_match (playlist_digits, &playlist);
+
+    if (irmpc_options.debug) {
+        printf ("number chosen: %s\n", playlist_digits);
+    }
+
+    playlist_digits[0] = '\0';
+
+    if (playlist != NULL) {
+        if (irmpc_options.debug) {
+            printf ("playlist: %s - random: %d\n", playlist->name, playlist->random);
+        }
+
+        irmpc_mpd_playlist (playlist);
+    }
+}
+
+/* no further digit within keytimespan */
+static gboolean irmpc_mpd_playlist_digits_timeout (gpointer data)
+{
+    irmpc_mpd_playlist_digits_commit ();
+    irmpc_mpd_deferred_release ();
+    irmpc_mpd_idle_enter ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* handle number key presses for playlist loading:
+ * load as soon as entered digits match exactly one playlist number,
+ * wait for more digits only while a longer number is possible */
+static void irmpc_mpd_playlist_key (int key)
+{
+    if ((key < 0) || (key > 9)) return;
+
+    size_t len = strlen (playlist_digits);
+
+    if (len + 1 >= sizeof (playlist_digits)) {
+        irmpc_mpd_playlist_digits_commit ();
+        len = 0;
+    }
+
+    playlist_digits[len]     = '0' + key;
+    playlist_digits[len + 1] = '\0';
+
+    const struct playlist_info *playlist = NULL;
+    enum irmpc_playlist_match   match    = irmpc_playlist_match (playlist_digits, &playlist);
+
+    if ((match == IRMPC_PLAYLIST_MATCH_NONE) && (len > 0)) {
+        /* digit does not continue entry: end it and start a new one */
+        playlist_digits[len] = '\0';
+        irmpc_mpd_playlist_digits_commit ();
+        irmpc_mpd_playlist_key (key);
+        return;
+    }
+
+    switch (match) {
+        case IRMPC_PLAYLIST_MATCH_NONE:
+            if (irmpc_options.debug) {
+                printf ("INFO: no playlist starting with %s\n", playlist_digits);
+            }
+            playlist_digits[0] = '\0';
+            break;
+        case IRMPC_PLAYLIST_MATCH_UNIQUE:
+            irmpc_mpd_playlist_digits_commit ();
+            break;
+        case IRMPC_PLAYLIST_MATCH_PREFIX:
+            irmpc_mpd_watch_remove (&playlist_digits_source);
+            playlist_digits_source = g_timeout_source_new (irmpc_options.lirc_key_timespan_ms);
+            g_source_set_callback (playlist_digits_source, irmpc_mpd_playlist_digits_timeout, NULL, NULL);
+            g_source_attach (playlist_digits_source, mpd_context);
+            break;
+    }
+}
+
+/* last volume setting for volume/mute */
+static __thread bool last_mute   = false;
+static __thread int  last_volume = 100;
+
+/* apply one volume/mute command to tracked volume state
+ * returns resulting mixer volume - -1 for unknown command */
+static int irmpc_mpd_volume_apply (const struct irmpc_command *command, int mixer_volume)
+{
+    int  current_volume = mixer_volume;
+    bool current_mute;
+
+    if (command->op == IRMPC_OP_VOLUME_UP) {
+        current_mute = false;
+        if (last_mute) {
+            current_volume = last_volume;
+        } else {
+            current_volume += irmpc_options.volume_step;
+        }
+    } else if (command->op == IRMPC_OP_VOLUME_DOWN) {
+        if (last_mute) {
+            current_mute   = true;
+            current_volume = last_volume;
+        } else {
+            current_mute    = false;
+            current_volume -= irmpc_options.volume_step;
+        }
+    } else if (command->op == IRMPC_OP_VOLUME_MUTE) {
+        if (last_mute) {
+            current_mute   = false;
+            current_volume = last_volume;
+        } else {
+            current_mute = true;
+        }
+    } else {
+        fprintf (stderr, "WARNING: ignoring command \"v:%s\" - unknown.\n", command->arg);
+        return -1;
+    }
+
+    if (current_volume < 0)   current_volume = 0;
+    if (current_volume > 100) current_volume = 100;
+
+    if (irmpc_options.debug) {
+        printf ("INFO: volume from %d (mute: %d) to %d (mute: %d)\n", last_volume, last_mute, current_volume, current_mute);
+    }
+
+    last_mute   = current_mute;
+    last_volume = current_volume;
+
+    return (current_mute ? 0 : current_volume);
+}
+
+/* setvol in flight + newer volume to send when it is answered (-1: none) */
+static __thread bool volume_in_flight = false;
+static __thread int  volume_target    = -1;
+
+static void irmpc_mpd_volume_set (int volume);
+
+/* setvol answered: send volume changed meanwhile - dropped if pipe failed */
+static void irmpc_mpd_volume_sent (bool success, unsigned int done, gpointer data)
+{
+    volume_in_flight = false;
+
+    if (!success) {
+        volume_target = -1;
+        return;
+    }
+
+    if (volume_target >= 0) {
+        int volume    = volume_target;
+        volume_target = -1;
+        irmpc_mpd_volume_set (volume);
+    }
+}
+
+/* set mixer volume - at most one setvol in flight, later ones replace each other */
+static void irmpc_mpd_volume_set (int volume)
+{
+    if (status_cache.valid) {
+        status_cache.volume = volume;
+    }
+
+    if (volume_in_flight) {
+        volume_target = volume;
+        return;
+    }
+
+    char volume_str [8];
+    snprintf (volume_str, sizeof (volume_str), "%d", volume);
+
+    volume_in_flight = true;
+    irmpc_mpd_pipe_send (irmpc_mpd_volume_sent, NULL, "setvol", volume_str, NULL);
+}
+
+/* volume/mute commands - folding all volume commands already waiting into one change */
+static void irmpc_mpd_volume (const struct irmpc_command *command)
+{
+    struct irmpc_mpd_status *status = irmpc_mpd_status ();
+    if (status == NULL) return;
+
+    int mixer_volume = status->volume;
+    int result       = irmpc_mpd_volume_apply (command, mixer_volume);
+    bool changed     = (result >= 0);
+
+    if (changed) mixer_volume = result;
+
+    const struct irmpc_command *next;
+    unsigned int coalesced = 0;
+
+    while (((next = irmpc_schedule_peek (mpd_schedule, g_get_monotonic_time ())) != NULL) && (next->type == IRMPC_COMMAND_VOLUME)) {
+        result = irmpc_mpd_volume_apply (next, mixer_volume);
+        if (result >= 0) {
+            mixer_volume = result;
+            changed      = true;
+        }
+
+        irmpc_schedule_pop (mpd_schedule, g_get_monotonic_time (), NULL);
+        coalesced++;
+    }
+
+    if (irmpc_options.debug && (coalesced > 0)) {
+        printf ("INFO: folded %u queued volume commands\n", coalesced);
+    }
+
+    if (changed) {
+        irmpc_mpd_volume_set (mixer_volume);
+    }
+
+    irmpc_mpd_completed (coalesced);
+}
+
+
+/* no timer holding back commands anymore: count deferred ones once answered */
+static void irmpc_mpd_deferred_release ()
+{
+    if ((skip_source != NULL) || (playlist_digits_source != NULL)) return;
+
+    irmpc_mpd_completed (mpd_commands_deferred);
+    mpd_commands_deferred = 0;
+}
+
+/* execute one command in executor thread */
+static void irmpc_mpd_execute (const struct irmpc_command *command)
+{
+    /* folded next/prev presses + numeric entry go first */
+    if ((command->op != IRMPC_OP_NEXT) && (command->op != IRMPC_OP_PREV)) {
+        irmpc_mpd_skip_flush ();
+    }
+    if (command->op != IRMPC_OP_PLAYLIST_KEY) {
+        irmpc_mpd_playlist_digits_commit ();
+    }
+
+    switch (command->type) {
+        case IRMPC_COMMAND_MPD:
+            irmpc_mpd_command (command);
+            irmpc_mpd_target_publish ();
+            break;
+        case IRMPC_COMMAND_VOLUME:
+            irmpc_mpd_volume (command);
+            break;
+        case IRMPC_COMMAND_PLAYLIST:
+            /* held digit key is no further digit */
+            if (command->repeat == 0) {
+                irmpc_mpd_playlist_key (command->number);
+            }
+            break;
+        case IRMPC_COMMAND_SYSTEM:
+            break;
+    }
+}
+
+/* command dropped by scheduler */
+static void irmpc_mpd_schedule_dropped (const struct irmpc_command *command, const char *reason)
+{
+    if (irmpc_options.verbose) {
+        printf ("INFO: dropping command %c:%s (%s)\n", "mvps"[command->type], command->arg, reason);
+    }
+
+    irmpc_mpd_executed (1);
+}
+
+/* move pushed commands to scheduler */
+static void irmpc_mpd_schedule_fill ()
+{
+    struct irmpc_command command;
+
+    while (irmpc_queue_pop (mpd_queue, &command)) {
+        irmpc_schedule_add (mpd_schedule, &command);
+    }
+}
+
+/* commands pushed: execute all of them by priority, then go idle again */
+static gboolean irmpc_mpd_queue_input (gint fd, GIOCondition condition, gpointer data)
+{
+    struct irmpc_command command;
+
+    irmpc_queue_clear_wakeup (mpd_queue);
+    irmpc_mpd_schedule_fill ();
+
+    while (irmpc_schedule_pop (mpd_schedule, g_get_monotonic_time (), &command)) {
+        irmpc_mpd_execute (&command);
+
+        /* executed once mpd answered it - or once folded keys are sent */
+        mpd_commands_deferred++;
+        irmpc_mpd_deferred_release ();
+
+        if ((!mpd_first_command_done) && irmpc_options.verbose) {
+            gint64 now = g_get_monotonic_time ();
+            printf ("INFO: first command on %s executed %lld ms after start (%lld ms after key press)\n", irmpc_mpd_target_name (),
+                    (long long) ((now - mpd_start_time) / 1000), (long long) ((now - command.time) / 1000));
+        }
+        mpd_first_command_done = true;
+
+        /* commands pushed meanwhile may preempt waiting ones */
+        irmpc_mpd_schedule_fill ();
+    }
+
+    irmpc_mpd_idle_enter ();
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* delay for next connection attempt at startup */
+static __thread guint    connect_delay_ms = 500;
+static __thread GSource *connect_source   = NULL;
+
+/* connect both connections at startup, retrying until mpd is reachable */
+static gboolean irmpc_mpd_connect (gpointer data)
+{
+    irmpc_mpd_watch_remove (&connect_source);
+
+    if (irmpc_connection_check () && irmpc_mpd_pipe_connect ()) {
+        if (irmpc_options.verbose) {
+            printf ("INFO: mpd session on %s ready %lld ms after start\n", irmpc_mpd_target_name (), (long long) ((g_get_monotonic_time () - mpd_start_time) / 1000));
+        }
+        irmpc_mpd_standby_check ();
+        irmpc_mpd_idle_enter ();
+        return G_SOURCE_REMOVE;
+    }
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: mpd on %s not reachable - trying again in %u ms\n", irmpc_mpd_target_name (), connect_delay_ms);
+    }
+
+    connect_source = g_timeout_source_new (connect_delay_ms);
+    g_source_set_callback (connect_source, irmpc_mpd_connect, NULL, NULL);
+    g_source_attach (connect_source, mpd_context);
+
+    if (connect_delay_ms < 16000) connect_delay_ms *= 2;
+
+    return G_SOURCE_REMOVE;
+}
+
+/* periodic check of connections - broken ones are replaced before next key press */
+static gboolean irmpc_mpd_keepalive (gpointer data)
+{
+    /* noidle round trip - dead link shows up as timeout */
+    if (connection != NULL) {
+        mpd_connection_set_timeout (connection, IRMPC_MPD_KEEPALIVE_TIMEOUT_MS);
+        irmpc_mpd_idle_leave ();
+
+        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+            fprintf (stderr, "ERROR: mpd keepalive failed: %s - reconnecting\n", mpd_connection_get_error_message (connection));
+            irmpc_mpd_connection_free ();
+        } else {
+            mpd_connection_set_timeout (connection, IRMPC_MPD_TIMEOUT_MS);
+        }
+    }
+
+    if (irmpc_connection_check ()) {
+        irmpc_mpd_standby_check ();
+        irmpc_mpd_pipe_keepalive ();
+    }
+    irmpc_mpd_idle_enter ();
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* (re)start keepalive timer with configured interval */
+static void irmpc_mpd_keepalive_start ()
+{
+    irmpc_mpd_watch_remove (&keepalive_source);
+
+    if (irmpc_options.mpd_keepalive == 0) return;
+
+    keepalive_source = g_timeout_source_new_seconds (irmpc_options.mpd_keepalive);
+    g_source_set_callback (keepalive_source, irmpc_mpd_keepalive, NULL, NULL);
+    g_source_attach (keepalive_source, mpd_context);
+}
+
+/* executor thread: run main loop handling queue + connection of one target */
+static gpointer irmpc_mpd_thread (gpointer data)
+{
+    mpd_target  = data;
+    mpd_context = mpd_target->context;
+    mpd_queue   = mpd_target->queue;
+
+    g_main_context_push_thread_default (mpd_context);
+
+    /* options stay as they are until a reload hands over new ones */
+    irmpc_options_use (mpd_target->options);
+    irmpc_options_unref (mpd_target->options);
+    mpd_target->options = NULL;
+
+    /* lookups only touch the own copy of the playlist table */
+    irmpc_playlist_table_set (mpd_target->table);
+    mpd_target->table = NULL;
+
+    /* numbers of stored playlists known from last run */
+    if (irmpc_options.mpd_autoplaylists) {
+        irmpc_mpd_playlists_load_cache (mpd_target->name);
+    }
+
+    mpd_schedule = irmpc_schedule_new (irmpc_mpd_schedule_dropped);
+
+    mpd_queue_source = irmpc_mpd_watch_add (irmpc_queue_fd (mpd_queue), irmpc_mpd_queue_input);
+    irmpc_mpd_pipe_init (mpd_context, irmpc_mpd_status_drained);
+
+    /* connect while waiting for lircd - first key press finds session ready */
+    irmpc_mpd_connect (NULL);
+    irmpc_mpd_keepalive_start ();
+
+    g_main_loop_run (mpd_target->loop);
+
+    irmpc_mpd_watch_remove (&mpd_queue_source);
+    irmpc_mpd_watch_remove (&connect_source);
+    irmpc_mpd_watch_remove (&keepalive_source);
+    irmpc_mpd_watch_remove (&skip_source);
+    irmpc_mpd_watch_remove (&playlist_digits_source);
+    irmpc_mpd_standby_probe_wait ();
+    irmpc_mpd_executed (mpd_commands_deferred);
+    mpd_commands_deferred = 0;
+    irmpc_schedule_free (mpd_schedule);
+    mpd_schedule = NULL;
+    irmpc_mpd_pipe_free ();
+    irmpc_mpd_connection_free ();
+    irmpc_mpd_standby_free ();
+    irmpc_mpd_queue_free ();
+    irmpc_mpd_partition_free ();
+    irmpc_mpd_playlists_free ();
+    irmpc_playlist_table_set (NULL);
+    irmpc_options_use (NULL);
+
+    g_main_context_pop_thread_default (mpd_context);
+
+    return NULL;
+}
+
+/* create target and start its executor thread - hosts NULL: hostname option */
+static bool irmpc_mpd_target_add (const char *name, const char *hosts)
+{
+    struct irmpc_mpd_target *target = g_new0 (struct irmpc_mpd_target, 1);
+    g_ptr_array_add (mpd_targets, target);
+
+    target->name     = g_strdup (name);
+    target->hosts    = g_strdup (hosts);
+    target->selected = true;
+    target->table    = irmpc_playlist_table_copy (NULL);
+    target->options  = irmpc_options_ref (&irmpc_options);
+
+    target->queue = irmpc_queue_new ();
+    if (target->queue == NULL) {
+        fprintf (stderr, "ERROR: failed to create mpd command queue\n");
+        return false;
+    }
+
+    target->context = g_main_context_new ();
+    target->loop    = g_main_loop_new (target->context, false);
+    target->thread  = g_thread_new ((name != NULL) ? name : "mpd", irmpc_mpd_thread, target);
+
+    return true;
+}
+
+/* start executor threads - one per room or one for hostname option */
+bool irmpc_mpd_init ()
+{
+    mpd_start_time  = g_get_monotonic_time ();
+    partition_nonce = g_random_int ();
+
+    g_mutex_init (&mpd_executed_mutex);
+    g_cond_init  (&mpd_executed_cond);
+
+    mpd_targets = g_ptr_array_new ();
+
+    if (irmpc_options.mpd_rooms == NULL) {
+        return irmpc_mpd_target_add (NULL, NULL);
+    }
+
+    for (int i = 0; irmpc_options.mpd_rooms[i] != NULL; i++) {
+        if (!irmpc_mpd_target_add (irmpc_options.mpd_rooms[i], irmpc_options.mpd_room_hosts[i])) return false;
+    }
+
+    return true;
+}
+
+/* whether target is one of names ("all": any) */
+static bool irmpc_mpd_target_matches (const struct irmpc_mpd_target *target, gchar **names)
+{
+    for (int n = 0; names[n] != NULL; n++) {
+        if ((strcmp (names[n], "all") == 0) || (g_strcmp0 (target->name, names[n]) == 0)) return true;
+    }
+
+    return false;
+}
+
+/* select targets commands go to: room names separated by '+' or "all" */
+bool irmpc_mpd_select (const char *rooms)
+{
+    if (mpd_targets == NULL) return false;
+
+    gchar      **names = g_strsplit (rooms, "+", 0);
+    unsigned int found = 0;
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        if (irmpc_mpd_target_matches (g_ptr_array_index (mpd_targets, i), names)) found++;
+    }
+
+    if (found == 0) {
+        fprintf (stderr, "WARNING: no room \"%s\" - keeping selection\n", rooms);
+        g_strfreev (names);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        struct irmpc_mpd_target *target = g_ptr_array_index (mpd_targets, i);
+        target->selected = irmpc_mpd_target_matches (target, names);
+    }
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: commands go to %s (%u of %u rooms)\n", rooms, found, mpd_targets->len);
+    }
+
+    g_strfreev (names);
+
+    return true;
+}
+
+/* toggles sent to several targets - resolved to one result for all of them */
+static const struct irmpc_mpd_toggle {
+    enum irmpc_opcode toggle;
+    gint              flag;
+    enum irmpc_opcode on;
+    enum irmpc_opcode off;
+} irmpc_mpd_toggles [] = {
+    {IRMPC_OP_PLAYPAUSE,    IRMPC_MPD_TARGET_PLAYING, IRMPC_OP_PLAY,   IRMPC_OP_PAUSE},
+    {IRMPC_OP_TOGGLEREPEAT, IRMPC_MPD_TARGET_REPEAT,  IRMPC_OP_REPEAT, IRMPC_OP_REPEATOFF},
+    {IRMPC_OP_TOGGLESINGLE, IRMPC_MPD_TARGET_SINGLE,  IRMPC_OP_SINGLE, IRMPC_OP_SINGLEOFF},
+    {IRMPC_OP_TOGGLERANDOM, IRMPC_MPD_TARGET_RANDOM,  IRMPC_OP_RANDOM, IRMPC_OP_RANDOMOFF},
+    {IRMPC_OP_UNKNOWN}
+};
+
+/* switch off if on in any selected target - else switch on everywhere */
+static void irmpc_mpd_toggle_resolve (struct irmpc_command *command)
+{
+    const struct irmpc_mpd_toggle *toggle = &(irmpc_mpd_toggles[0]);
+    while ((toggle->toggle != IRMPC_OP_UNKNOWN) && (toggle->toggle != command->op)) toggle++;
+
+    if (toggle->toggle == IRMPC_OP_UNKNOWN) return;
+
+    unsigned int selected = 0;
+    bool         on       = false;
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        struct irmpc_mpd_target *target = g_ptr_array_index (mpd_targets, i);
+        if (!target->selected) continue;
+
+        selected++;
+        if (g_atomic_int_get (&(target->flags)) & toggle->flag) on = true;
+    }
+
+    /* single target toggles by own status */
+    if (selected < 2) return;
+
+    command->op = (on ? toggle->off : toggle->on);
+}
+
+/* pass command to executor threads of selected targets - never blocks */
+bool irmpc_mpd_push (const struct irmpc_command *command)
+{
+    if (mpd_targets == NULL) return false;
+
+    struct irmpc_command stamped = *command;
+    stamped.time = g_get_monotonic_time ();
+
+    irmpc_mpd_toggle_resolve (&stamped);
+
+    unsigned int pushed = 0;
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        struct irmpc_mpd_target *target = g_ptr_array_index (mpd_targets, i);
+        if (!target->selected) continue;
+
+        if (!irmpc_queue_push (target->queue, &stamped)) {
+            fprintf (stderr, "WARNING: mpd command queue of %s full - dropping command\n", (target->name != NULL) ? target->name : "mpd");
+            continue;
+        }
+        pushed++;
+    }
+
+    g_mutex_lock (&mpd_executed_mutex);
+    mpd_commands_pushed += pushed;
+    g_mutex_unlock (&mpd_executed_mutex);
+
+    return (pushed > 0);
+}
+
+/* reloaded playlist table + options passed to executor thread */
+struct irmpc_mpd_reload {
+    struct irmpc_playlist_table *table;
+    const struct _irmpc_options *options;
+};
+
+/* swap in reloaded playlist table + options between two commands (executor thread) */
+static gboolean irmpc_mpd_reload_apply (gpointer data)
+{
+    struct irmpc_mpd_reload *reload = data;
+
+    irmpc_playlist_table_set (reload->table);
+    irmpc_options_use (reload->options);
+    irmpc_options_unref (reload->options);
+    g_free (reload);
+
+    /* host list or interval might have changed */
+    irmpc_mpd_standby_free ();
+    irmpc_mpd_keepalive_start ();
+
+    /* add discovered playlists to new table */
+    if (irmpc_options.mpd_autoplaylists) {
+        irmpc_mpd_playlists_free ();
+        irmpc_mpd_playlists_load_cache (mpd_target->name);
+
+        if ((connection != NULL) && irmpc_connection_check ()) {
+            irmpc_mpd_playlists_sync (connection);
+        }
+        irmpc_mpd_idle_enter ();
+    }
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: playlist table of %s reloaded\n", irmpc_mpd_target_name ());
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* use reloaded playlist table + published options - takes ownership of table, each target gets own copy */
+void irmpc_mpd_reload (struct irmpc_playlist_table *table)
+{
+    if ((mpd_targets == NULL) || (mpd_targets->len == 0)) {
+        irmpc_playlist_table_set (table);
+        return;
+    }
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        struct irmpc_mpd_target     *target = g_ptr_array_index (mpd_targets, i);
+        struct irmpc_mpd_reload     *reload = g_new (struct irmpc_mpd_reload, 1);
+
+        reload->table   = (i + 1 < mpd_targets->len) ? irmpc_playlist_table_copy (table) : table;
+        reload->options = irmpc_options_ref (&irmpc_options);
+
+        g_main_context_invoke (target->context, irmpc_mpd_reload_apply, reload);
+    }
+}
+
+/* wait until mpd answered all pushed commands or timeout expired */
+bool irmpc_mpd_wait (unsigned int timeout_ms)
+{
+    if (mpd_targets == NULL) return false;
+
+    gint64 end_time = g_get_monotonic_time () + ((gint64) timeout_ms) * 1000;
+    bool   done     = true;
+
+    g_mutex_lock (&mpd_executed_mutex);
+    while (mpd_commands_executed != mpd_commands_pushed) {
+        if (!g_cond_wait_until (&mpd_executed_cond, &mpd_executed_mutex, end_time)) {
+            done = false;
+            break;
+        }
+    }
+    g_mutex_unlock (&mpd_executed_mutex);
+
+    return done;
+}
+
+/* free connection struct */
+static void irmpc_mpd_connection_free ()
+{
+    irmpc_mpd_watch_remove (&connection_idle_source);
+    connection_idle = false;
+
+    status_cache.valid = false;
+    irmpc_mpd_queue_invalidate ();
+
+    if (connection != NULL) {
+        mpd_connection_free (connection);
+        connection = NULL;
+    }
+
+    g_free (connection_host);
+    connection_host = NULL;
+}
+
+/* stop executor threads and free all resources */
+void irmpc_mpd_free ()
+{
+    if (mpd_targets == NULL) return;
+
+    for (unsigned int i = 0; i < mpd_targets->len; i++) {
+        struct irmpc_mpd_target *target = g_ptr_array_index (mpd_targets, i);
+
+        if (target->thread != NULL) {
+            g_main_loop_quit (target->loop);
+            g_thread_join (target->thread);
+        }
+
+        if (target->loop != NULL) {
+            g_main_loop_unref (target->loop);
+            g_main_context_unref (target->context);
+        }
+
+        if (target->queue != NULL) {
+            irmpc_queue_free (target->queue);
+        }
+
+        irmpc_playlist_table_free (target->table);
+        irmpc_options_unref (target->options);
+        g_free (target->name);
+        g_free (target->hosts);
+        g_free (target);
+    }
+
+    g_ptr_array_free (mpd_targets, true);
+    mpd_targets = NULL;
+
+    g_mutex_clear (&mpd_executed_mutex);
+    g_cond_clear  (&mpd_executed_cond);
+}
@@ -1,9 +1,17 @@
-#ifndef __mpd_hv_
+#ifndef __mpd_h__
 #define __mpd_h__
 
-void irmpc_mpd_command (const char *command);
-void irmpc_mpd_playlist_key (int key);
-void irmpc_mpd_volume (const char *command);
+#include "command.h"
+
+#include <stdbool.h>
+
+struct irmpc_playlist_table;
+
+bool irmpc_mpd_init ();
+bool irmpc_mpd_push (const struct irmpc_command *command);
+bool irmpc_mpd_select (const char *rooms);
+bool irmpc_mpd_wait (unsigned int timeout_ms);
+void irmpc_mpd_reload (struct irmpc_playlist_table *table);
 
 void irmpc_mpd_free ();
 
@@ -0,0 +1,721 @@
+#include "mpdpipe.h"
+#include "options.h"
+
+#include <glib-unix.h>
+#include <mpd/async.h>
+#include <mpd/parser.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* timeout for connecting and synchronous handshake */
+#define IRMPC_MPD_PIPE_TIMEOUT_MS 5000
+/* maximum number of arguments of a pipelined command */
+#define IRMPC_MPD_PIPE_ARGS_MAX   4
+
+/* maximum number of commands in a command list */
+#define IRMPC_MPD_PIPE_LIST_MAX   16
+
+/* command + arguments, NULL padded */
+typedef gchar *irmpc_mpd_pipe_command [IRMPC_MPD_PIPE_ARGS_MAX + 2];
+
+/* callback waiting for a request and all before it to be answered */
+struct irmpc_mpd_pipe_barrier {
+    irmpc_mpd_pipe_barrier_callback callback;
+    gpointer                        data;
+};
+
+/* command or command list waiting to be sent or for its response */
+struct irmpc_mpd_pipe_request {
+    irmpc_mpd_pipe_command   commands [IRMPC_MPD_PIPE_LIST_MAX];
+    unsigned int             count;
+    /* commands of list completed successfully + already removed on resume */
+    unsigned int             done;
+    unsigned int             offset;
+    /* partition entered by removed commands - entered again first when resuming */
+    gchar                   *partition;
+    /* responses of commands written ahead of list (partition) not counted as done */
+    unsigned int             prefix;
+    bool                     list;
+    /* IRMPC_MPD_PIPE_* */
+    unsigned int             flags;
+    /* output flushed to socket - mpd might have executed it */
+    bool                     written;
+    unsigned int             tries;
+    irmpc_mpd_pipe_callback  callback;
+    gpointer                 data;
+    /* barriers reached once answered - latest first */
+    GSList                  *barriers;
+};
+
+/* all state per executor thread - each target has its own pipe */
+/* async connection + response parser */
+static __thread struct mpd_async  *pipe_async     = NULL;
+static __thread struct mpd_parser *pipe_parser    = NULL;
+/* main context of executor thread + watch of connection fd */
+static __thread GMainContext      *pipe_context   = NULL;
+static __thread GSource           *pipe_source    = NULL;
+static __thread GIOCondition       pipe_condition = 0;
+/* requests sent, in order of expected responses */
+static __thread GQueue             pipe_pending   = G_QUEUE_INIT;
+/* host connected to + partition to enter after (re)connecting - NULL: default */
+static __thread gchar             *pipe_host      = NULL;
+static __thread gchar             *pipe_partition = NULL;
+/* keepalive ping sent, not answered yet */
+static __thread bool               pipe_ping      = false;
+/* notification when no more requests are pending */
+static __thread irmpc_mpd_pipe_drained_callback pipe_drained = NULL;
+
+static bool irmpc_mpd_pipe_submit (struct irmpc_mpd_pipe_request *request);
+
+/* report result, notify barriers and free request */
+static void irmpc_mpd_pipe_request_finish (struct irmpc_mpd_pipe_request *request, bool success)
+{
+    if (success) {
+        request->done = request->count;
+    }
+
+    GList *tail = pipe_pending.tail;
+
+    if (request->callback != NULL) {
+        request->callback (success, request->offset + request->done, request->data);
+    }
+
+    if ((pipe_pending.tail != NULL) && (pipe_pending.tail != tail)) {
+        /* callback sent follow-up requests (e.g. deferred setvol): barriers wait for them too */
+        struct irmpc_mpd_pipe_request *follow_up = pipe_pending.tail->data;
+        follow_up->barriers = g_slist_concat (follow_up->barriers, request->barriers);
+    } else {
+        request->barriers = g_slist_reverse (request->barriers);
+        for (GSList *item = request->barriers; item != NULL; item = item->next) {
+            struct irmpc_mpd_pipe_barrier *barrier = item->data;
+            barrier->callback (barrier->data);
+        }
+        g_slist_free_full (request->barriers, g_free);
+    }
+
+    for (unsigned int c = 0; c < request->count; c++) {
+        for (int i = 0; request->commands[c][i] != NULL; i++) {
+            g_free (request->commands[c][i]);
+        }
+    }
+    g_free (request->partition);
+    g_free (request);
+}
+
+/* open socket to mpd (unix socket path or host + port) */
+static int irmpc_mpd_pipe_connect_fd (const char *host)
+{
+    int fd = -1;
+
+    if (host[0] == '/') {
+        struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+        if (strlen (host) >= sizeof (address.sun_path)) return -1;
+        strcpy (address.sun_path, host);
+
+        fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1) return -1;
+
+        if (connect (fd, (struct sockaddr *) &address, sizeof (address)) != 0) {
+            close (fd);
+            return -1;
+        }
+
+        fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+    struct addrinfo  hints   = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *results = NULL;
+    char             port [8];
+
+    snprintf (port, sizeof (port), "%u", irmpc_options.mpd_port);
+
+    if (getaddrinfo (host, port, &hints, &results) != 0) return -1;
+
+    for (struct addrinfo *ai = results; ai != NULL; ai = ai->ai_next) {
+        fd = socket (ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol);
+        if (fd == -1) continue;
+
+        if (connect (fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+
+        if (errno == EINPROGRESS) {
+            /* wait for non-blocking connect */
+            struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+            int       so_error = 0;
+            socklen_t so_len   = sizeof (so_error);
+
+            if ((poll (&pfd, 1, IRMPC_MPD_PIPE_TIMEOUT_MS) == 1) &&
+                (getsockopt (fd, SOL_SOCKET, SO_ERROR, &so_error, &so_len) == 0) && (so_error == 0)) {
+                break;
+            }
+        }
+
+        close (fd);
+        fd = -1;
+    }
+
+    freeaddrinfo (results);
+
+    return fd;
+}
+
+/* output buffer empty: all pending requests reached the socket */
+static void irmpc_mpd_pipe_flushed ()
+{
+    if (mpd_async_events (pipe_async) & MPD_ASYNC_EVENT_WRITE) return;
+
+    for (GList *item = pipe_pending.head; item != NULL; item = item->next) {
+        ((struct irmpc_mpd_pipe_request *) item->data)->written = true;
+    }
+}
+
+/* do io on connection - writing first, so written requests are known even if reading fails after */
+static bool irmpc_mpd_pipe_do_io (enum mpd_async_event events)
+{
+    if (events & MPD_ASYNC_EVENT_WRITE) {
+        if (!mpd_async_io (pipe_async, MPD_ASYNC_EVENT_WRITE)) return false;
+        irmpc_mpd_pipe_flushed ();
+    }
+
+    events &= ~MPD_ASYNC_EVENT_WRITE;
+    if (events == 0) return true;
+
+    return mpd_async_io (pipe_async, events);
+}
+
+/* wait for connection events (blocking) and do io - used for handshake and flushing */
+static bool irmpc_mpd_pipe_io_sync ()
+{
+    enum mpd_async_event events = mpd_async_events (pipe_async);
+    struct pollfd pfd = {.fd = mpd_async_get_fd (pipe_async), .events = 0};
+
+    if (events & MPD_ASYNC_EVENT_READ)  pfd.events |= POLLIN;
+    if (events & MPD_ASYNC_EVENT_WRITE) pfd.events |= POLLOUT;
+
+    if (poll (&pfd, 1, IRMPC_MPD_PIPE_TIMEOUT_MS) != 1) return false;
+
+    events = 0;
+    if (pfd.revents & POLLIN)  events |= MPD_ASYNC_EVENT_READ;
+    if (pfd.revents & POLLOUT) events |= MPD_ASYNC_EVENT_WRITE;
+    if (pfd.revents & POLLHUP) events |= MPD_ASYNC_EVENT_HUP;
+    if (pfd.revents & POLLERR) events |= MPD_ASYNC_EVENT_ERROR;
+
+    return irmpc_mpd_pipe_do_io (events);
+}
+
+/* receive one line (blocking) - used for handshake */
+static char * irmpc_mpd_pipe_recv_line_sync ()
+{
+    char *line;
+
+    while ((line = mpd_async_recv_line (pipe_async)) == NULL) {
+        if (mpd_async_get_error (pipe_async) != MPD_ERROR_SUCCESS) return NULL;
+        if (!irmpc_mpd_pipe_io_sync ()) return NULL;
+    }
+
+    return line;
+}
+
+/* close connection without touching pending requests */
+static void irmpc_mpd_pipe_close ()
+{
+    if (pipe_source != NULL) {
+        g_source_destroy (pipe_source);
+        g_source_unref (pipe_source);
+        pipe_source    = NULL;
+        pipe_condition = 0;
+    }
+
+    if (pipe_parser != NULL) {
+        mpd_parser_free (pipe_parser);
+        pipe_parser = NULL;
+    }
+
+    if (pipe_async != NULL) {
+        mpd_async_free (pipe_async);
+        pipe_async = NULL;
+    }
+}
+
+/* send command with one argument and wait for its response - used for handshake */
+static bool irmpc_mpd_pipe_run_sync (const char *command, const char *arg)
+{
+    if (!mpd_async_send_command (pipe_async, command, arg, NULL)) return false;
+
+    char *line;
+    enum mpd_parser_result result = MPD_PARSER_PAIR;
+    while (result == MPD_PARSER_PAIR) {
+        line = irmpc_mpd_pipe_recv_line_sync ();
+        if (line == NULL) return false;
+        result = mpd_parser_feed (pipe_parser, line);
+    }
+
+    return (result == MPD_PARSER_SUCCESS);
+}
+
+/* connect, check greeting, send password and enter partition */
+static bool irmpc_mpd_pipe_open ()
+{
+    if (pipe_host == NULL) return false;
+
+    if (irmpc_options.debug) {
+        printf ("INFO: opening pipelined connection to %s:%d\n", pipe_host, irmpc_options.mpd_port);
+    }
+
+    int fd = irmpc_mpd_pipe_connect_fd (pipe_host);
+    if (fd == -1) {
+        fprintf (stderr, "ERROR: pipelined mpd connection failed: %s\n", strerror (errno));
+        return false;
+    }
+
+    pipe_async  = mpd_async_new (fd);
+    pipe_parser = mpd_parser_new ();
+    if ((pipe_async == NULL) || (pipe_parser == NULL)) {
+        if (pipe_async == NULL) close (fd);
+        irmpc_mpd_pipe_close ();
+        return false;
+    }
+
+    char *line = irmpc_mpd_pipe_recv_line_sync ();
+    if ((line == NULL) || (strncmp (line, "OK MPD ", 7) != 0)) {
+        fprintf (stderr, "ERROR: pipelined mpd connection: unexpected greeting\n");
+        irmpc_mpd_pipe_close ();
+        return false;
+    }
+
+    if ((irmpc_options.mpd_password != NULL) && (!irmpc_mpd_pipe_run_sync ("password", irmpc_options.mpd_password))) {
+        fprintf (stderr, "ERROR: password failed\n");
+        irmpc_mpd_pipe_close ();
+        return false;
+    }
+
+    if ((pipe_partition != NULL) && (!irmpc_mpd_pipe_run_sync ("partition", pipe_partition))) {
+        fprintf (stderr, "ERROR: switching to partition %s failed\n", pipe_partition);
+        irmpc_mpd_pipe_close ();
+        return false;
+    }
+
+    return true;
+}
+
+/* connection broken: close and resubmit pending requests in order
+ * written commands might have been executed - they are reported as failed instead of repeated,
+ * written command lists are resumed after the last command confirmed */
+static void irmpc_mpd_pipe_failed ()
+{
+    GQueue failed = pipe_pending;
+    g_queue_init (&pipe_pending);
+
+    if ((pipe_async != NULL) && (mpd_async_get_error (pipe_async) != MPD_ERROR_SUCCESS)) {
+        fprintf (stderr, "ERROR: pipelined mpd connection: %s\n", mpd_async_get_error_message (pipe_async));
+    }
+
+    irmpc_mpd_pipe_close ();
+
+    struct irmpc_mpd_pipe_request *request;
+    while ((request = g_queue_pop_head (&failed)) != NULL) {
+        if (request->written && (!request->list) && (!(request->flags & IRMPC_MPD_PIPE_REPEAT))) {
+            fprintf (stderr, "WARNING: mpd command \"%s\" not confirmed before connection was lost - not repeated\n", request->commands[0][0]);
+            irmpc_mpd_pipe_request_finish (request, false);
+        } else {
+            irmpc_mpd_pipe_submit (request);
+        }
+    }
+}
+
+/* handle all complete response lines */
+static bool irmpc_mpd_pipe_receive ()
+{
+    char *line;
+
+    while ((line = mpd_async_recv_line (pipe_async)) != NULL) {
+        enum mpd_parser_result result = mpd_parser_feed (pipe_parser, line);
+        struct irmpc_mpd_pipe_request *request;
+
+        switch (result) {
+            case MPD_PARSER_PAIR:
+                break;
+            case MPD_PARSER_SUCCESS:
+                if (mpd_parser_is_discrete (pipe_parser)) {
+                    /* list_OK: one command of list done */
+                    request = g_queue_peek_head (&pipe_pending);
+                    if (request == NULL) break;
+
+                    if (request->prefix > 0) {
+                        request->prefix--;
+                    } else {
+                        request->done++;
+                    }
+                    break;
+                }
+                request = g_queue_pop_head (&pipe_pending);
+                if (request != NULL) {
+                    irmpc_mpd_pipe_request_finish (request, true);
+                }
+                break;
+            case MPD_PARSER_ERROR:
+                request = g_queue_pop_head (&pipe_pending);
+                if (request == NULL) break;
+
+                if (!request->list) {
+                    if (!(request->flags & IRMPC_MPD_PIPE_QUIET)) {
+                        fprintf (stderr, "ERROR: mpd command \"%s\" failed: %s\n", request->commands[0][0], mpd_parser_get_message (pipe_parser));
+                    } else if (irmpc_options.debug) {
+                        printf ("INFO: mpd command \"%s\" failed as expected: %s\n", request->commands[0][0], mpd_parser_get_message (pipe_parser));
+                    }
+                    irmpc_mpd_pipe_request_finish (request, false);
+                    break;
+                }
+
+                /* position in list as written - partition entered ahead counts */
+                unsigned int at = mpd_parser_get_at (pipe_parser);
+                fprintf (stderr, "ERROR: mpd command \"%s\" failed: %s\n", (at < request->prefix) ? "partition" : request->commands[at - request->prefix][0], mpd_parser_get_message (pipe_parser));
+
+                /* resume command list at failed command */
+                request->done = (at < request->prefix) ? 0 : at - request->prefix;
+                irmpc_mpd_pipe_submit (request);
+                break;
+            case MPD_PARSER_MALFORMED:
+                fprintf (stderr, "ERROR: pipelined mpd connection: malformed response\n");
+                return false;
+        }
+
+        /* callbacks might have closed the connection */
+        if (pipe_async == NULL) return true;
+
+        if ((result != MPD_PARSER_PAIR) && g_queue_is_empty (&pipe_pending) && (pipe_drained != NULL)) {
+            pipe_drained ();
+        }
+    }
+
+    return (mpd_async_get_error (pipe_async) == MPD_ERROR_SUCCESS);
+}
+
+static void irmpc_mpd_pipe_update_watch ();
+
+/* connection fd ready */
+static gboolean irmpc_mpd_pipe_io (gint fd, GIOCondition condition, gpointer data)
+{
+    enum mpd_async_event events = 0;
+
+    if (condition & G_IO_IN)  events |= MPD_ASYNC_EVENT_READ;
+    if (condition & G_IO_OUT) events |= MPD_ASYNC_EVENT_WRITE;
+    if (condition & G_IO_HUP) events |= MPD_ASYNC_EVENT_HUP;
+    if (condition & G_IO_ERR) events |= MPD_ASYNC_EVENT_ERROR;
+
+    if ((!irmpc_mpd_pipe_do_io (events)) || (!irmpc_mpd_pipe_receive ())) {
+        irmpc_mpd_pipe_failed ();
+        return G_SOURCE_CONTINUE;
+    }
+
+    irmpc_mpd_pipe_update_watch ();
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* (re)create fd watch matching the events the connection waits for */
+static void irmpc_mpd_pipe_update_watch ()
+{
+    if (pipe_async == NULL) return;
+
+    enum mpd_async_event events = mpd_async_events (pipe_async);
+    GIOCondition condition = G_IO_HUP | G_IO_ERR;
+
+    if (events & MPD_ASYNC_EVENT_READ)  condition |= G_IO_IN;
+    if (events & MPD_ASYNC_EVENT_WRITE) condition |= G_IO_OUT;
+
+    if ((pipe_source != NULL) && (condition == pipe_condition)) return;
+
+    if (pipe_source != NULL) {
+        g_source_destroy (pipe_source);
+        g_source_unref (pipe_source);
+    }
+
+    pipe_condition = condition;
+    pipe_source    = g_unix_fd_source_new (mpd_async_get_fd (pipe_async), condition);
+    g_source_set_callback (pipe_source, (GSourceFunc) irmpc_mpd_pipe_io, NULL, NULL);
+    g_source_attach (pipe_source, pipe_context);
+}
+
+/* buffer one command for sending - flushing output if buffer is full */
+static bool irmpc_mpd_pipe_write (gchar **a)
+{
+    if (mpd_async_send_command (pipe_async, a[0], a[1], a[2], a[3], a[4], NULL)) return true;
+    if (mpd_async_get_error (pipe_async) != MPD_ERROR_SUCCESS) return false;
+
+    /* output buffer full - flush and try again */
+    if (!(irmpc_mpd_pipe_io_sync () && irmpc_mpd_pipe_receive ())) return false;
+
+    return mpd_async_send_command (pipe_async, a[0], a[1], a[2], a[3], a[4], NULL);
+}
+
+/* command list resumed: drop commands done, done counted relative to remaining ones */
+static void irmpc_mpd_pipe_list_resume (struct irmpc_mpd_pipe_request *request)
+{
+    unsigned int first = request->done;
+    if (first == 0) return;
+
+    for (unsigned int c = 0; c < first; c++) {
+        if ((strcmp (request->commands[c][0], "partition") == 0) && (request->commands[c][1] != NULL)) {
+            g_free (request->partition);
+            request->partition = g_strdup (request->commands[c][1]);
+        }
+        for (int i = 0; request->commands[c][i] != NULL; i++) {
+            g_free (request->commands[c][i]);
+        }
+    }
+
+    memmove (request->commands[0], request->commands[first], (request->count - first) * sizeof (irmpc_mpd_pipe_command));
+    memset (request->commands[request->count - first], 0, first * sizeof (irmpc_mpd_pipe_command));
+
+    request->count  -= first;
+    request->offset += first;
+    request->done    = 0;
+}
+
+/* write request to connection - (re)connecting and retrying up to maxtries
+ * command lists are (re)sent starting at the first command not yet done */
+static bool irmpc_mpd_pipe_submit (struct irmpc_mpd_pipe_request *request)
+{
+    static gchar *list_begin [] = {"command_list_ok_begin", NULL, NULL, NULL, NULL, NULL};
+    static gchar *list_end   [] = {"command_list_end",      NULL, NULL, NULL, NULL, NULL};
+
+    if (request->list) irmpc_mpd_pipe_list_resume (request);
+
+    while (request->tries < irmpc_options.mpd_maxtries) {
+        request->tries++;
+
+        if ((pipe_async == NULL) && (!irmpc_mpd_pipe_open ())) continue;
+
+        bool sent = true;
+
+        request->written = false;
+        request->prefix  = 0;
+
+        if (request->list) sent = irmpc_mpd_pipe_write (list_begin);
+        if (request->list && sent && (request->partition != NULL)) {
+            gchar *enter [] = {"partition", request->partition, NULL, NULL, NULL, NULL};
+            sent = irmpc_mpd_pipe_write (enter);
+            request->prefix = 1;
+        }
+        for (unsigned int c = 0; sent && (c < request->count); c++) {
+            sent = irmpc_mpd_pipe_write (request->commands[c]);
+        }
+        if (request->list && sent) sent = irmpc_mpd_pipe_write (list_end);
+
+        if (sent) {
+            g_queue_push_tail (&pipe_pending, request);
+            irmpc_mpd_pipe_update_watch ();
+            return true;
+        }
+
+        irmpc_mpd_pipe_failed ();
+    }
+
+    fprintf (stderr, "ERROR: giving up sending mpd command \"%s\"\n", request->commands[0][0]);
+    irmpc_mpd_pipe_request_finish (request, false);
+
+    return false;
+}
+
+/* set main context used for watching the connection + drained notification */
+bool irmpc_mpd_pipe_init (GMainContext *context, irmpc_mpd_pipe_drained_callback drained)
+{
+    pipe_context = context;
+    pipe_drained = drained;
+
+    return true;
+}
+
+/* copy command with NULL terminated list of arguments into request */
+static void irmpc_mpd_pipe_add_v (struct irmpc_mpd_pipe_request *request, const char *command, va_list ap)
+{
+    if (request->count >= IRMPC_MPD_PIPE_LIST_MAX) {
+        fprintf (stderr, "WARNING: mpd command list too long - dropping \"%s\"\n", command);
+        return;
+    }
+
+    gchar **args = request->commands[request->count++];
+
+    args[0] = g_strdup (command);
+    for (int i = 1; i <= IRMPC_MPD_PIPE_ARGS_MAX; i++) {
+        const char *arg = va_arg (ap, const char *);
+        if (arg == NULL) break;
+        args[i] = g_strdup (arg);
+    }
+}
+
+/* send single command without waiting for its response */
+static bool irmpc_mpd_pipe_send_v (unsigned int flags, irmpc_mpd_pipe_callback callback, gpointer data, const char *command, va_list ap)
+{
+    struct irmpc_mpd_pipe_request *request = g_new0 (struct irmpc_mpd_pipe_request, 1);
+
+    request->callback = callback;
+    request->data     = data;
+    request->flags    = flags;
+
+    irmpc_mpd_pipe_add_v (request, command, ap);
+
+    if (irmpc_options.debug) {
+        printf ("INFO: pipelining mpd command \"%s\" (%u in flight)\n", command, g_queue_get_length (&pipe_pending));
+    }
+
+    return irmpc_mpd_pipe_submit (request);
+}
+
+/* send command with NULL terminated list of arguments without waiting for its response */
+bool irmpc_mpd_pipe_send (irmpc_mpd_pipe_callback callback, gpointer data, const char *command, ...)
+{
+    va_list ap;
+    va_start (ap, command);
+    bool result = irmpc_mpd_pipe_send_v (0, callback, data, command, ap);
+    va_end (ap);
+
+    return result;
+}
+
+/* send command with IRMPC_MPD_PIPE_* flags */
+bool irmpc_mpd_pipe_send_flags (unsigned int flags, irmpc_mpd_pipe_callback callback, gpointer data, const char *command, ...)
+{
+    va_list ap;
+    va_start (ap, command);
+    bool result = irmpc_mpd_pipe_send_v (flags, callback, data, command, ap);
+    va_end (ap);
+
+    return result;
+}
+
+/* start command list - executed by mpd as a whole, answered in one response */
+struct irmpc_mpd_pipe_request * irmpc_mpd_pipe_list_new (irmpc_mpd_pipe_callback callback, gpointer data)
+{
+    struct irmpc_mpd_pipe_request *request = g_new0 (struct irmpc_mpd_pipe_request, 1);
+
+    request->callback = callback;
+    request->data     = data;
+    request->list     = true;
+
+    return request;
+}
+
+/* append command with NULL terminated list of arguments to command list */
+void irmpc_mpd_pipe_list_add (struct irmpc_mpd_pipe_request *request, const char *command, ...)
+{
+    va_list ap;
+    va_start (ap, command);
+    irmpc_mpd_pipe_add_v (request, command, ap);
+    va_end (ap);
+}
+
+/* send command list without waiting for its response */
+bool irmpc_mpd_pipe_list_send (struct irmpc_mpd_pipe_request *request)
+{
+    if (irmpc_options.debug) {
+        printf ("INFO: pipelining mpd command list of %u commands (%u in flight)\n", request->count, g_queue_get_length (&pipe_pending));
+    }
+
+    return irmpc_mpd_pipe_submit (request);
+}
+
+/* call callback once all requests sent so far are answered (or given up) - at once if none is pending */
+void irmpc_mpd_pipe_barrier (irmpc_mpd_pipe_barrier_callback callback, gpointer data)
+{
+    struct irmpc_mpd_pipe_request *request = g_queue_peek_tail (&pipe_pending);
+
+    if (request == NULL) {
+        callback (data);
+        return;
+    }
+
+    struct irmpc_mpd_pipe_barrier *barrier = g_new (struct irmpc_mpd_pipe_barrier, 1);
+    barrier->callback = callback;
+    barrier->data     = data;
+
+    request->barriers = g_slist_prepend (request->barriers, barrier);
+}
+
+/* open connection ahead of first command */
+bool irmpc_mpd_pipe_connect ()
+{
+    if (pipe_async != NULL) return true;
+
+    return irmpc_mpd_pipe_open ();
+}
+
+/* set host to connect to - pending requests move over to new host */
+void irmpc_mpd_pipe_set_host (const char *host)
+{
+    if (g_strcmp0 (host, pipe_host) == 0) return;
+
+    g_free (pipe_host);
+    pipe_host = g_strdup (host);
+
+    if (pipe_async != NULL) {
+        irmpc_mpd_pipe_failed ();
+    }
+}
+
+static void irmpc_mpd_pipe_pong (bool success, unsigned int done, gpointer data)
+{
+    pipe_ping = false;
+}
+
+/* check connection by ping - previous ping still unanswered: reconnect */
+void irmpc_mpd_pipe_keepalive ()
+{
+    if (pipe_async != NULL) {
+        if (pipe_ping) {
+            fprintf (stderr, "ERROR: pipelined mpd connection not responding - reconnecting\n");
+            irmpc_mpd_pipe_failed ();
+        } else if (g_queue_is_empty (&pipe_pending)) {
+            pipe_ping = true;
+            irmpc_mpd_pipe_send (irmpc_mpd_pipe_pong, NULL, "ping", NULL);
+        }
+    }
+
+    /* broken connection is only reopened on next request otherwise */
+    irmpc_mpd_pipe_connect ();
+}
+
+/* set partition entered after reconnecting - NULL: default */
+void irmpc_mpd_pipe_set_partition (const char *partition)
+{
+    g_free (pipe_partition);
+    pipe_partition = g_strdup (partition);
+}
+
+/* number of commands waiting for response */
+unsigned int irmpc_mpd_pipe_pending ()
+{
+    return g_queue_get_length (&pipe_pending);
+}
+
+/* close connection - pending requests are reported as failed */
+void irmpc_mpd_pipe_free ()
+{
+    irmpc_mpd_pipe_close ();
+
+    struct irmpc_mpd_pipe_request *request;
+    while ((request = g_queue_pop_head (&pipe_pending)) != NULL) {
+        irmpc_mpd_pipe_request_finish (request, false);
+    }
+
+    pipe_context = NULL;
+    pipe_drained = NULL;
+
+    g_free (pipe_partition);
+    g_free (pipe_host);
+    pipe_partition = NULL;
+    pipe_host      = NULL;
+    pipe_ping      = false;
+}
@@ -0,0 +1,37 @@
+#ifndef __mpdpipe_h__
+#define __mpdpipe_h__
+
+#include <stdbool.h>
+#include <glib.h>
+
+/* called in executor thread when response to a pipelined command (list) arrived
+ * done: number of commands executed successfully */
+typedef void (*irmpc_mpd_pipe_callback) (bool success, unsigned int done, gpointer data);
+/* called in executor thread when all pipelined commands are answered */
+typedef void (*irmpc_mpd_pipe_drained_callback) ();
+/* called in executor thread when all commands sent before barrier are answered */
+typedef void (*irmpc_mpd_pipe_barrier_callback) (gpointer data);
+
+/* flags of single commands */
+#define IRMPC_MPD_PIPE_QUIET  (1 << 0)  /* failing is expected - not reported                */
+#define IRMPC_MPD_PIPE_REPEAT (1 << 1)  /* safe to send again if connection was lost after it */
+
+bool         irmpc_mpd_pipe_init    (GMainContext *context, irmpc_mpd_pipe_drained_callback drained);
+bool         irmpc_mpd_pipe_send    (irmpc_mpd_pipe_callback callback, gpointer data, const char *command, ...);
+bool         irmpc_mpd_pipe_send_flags (unsigned int flags, irmpc_mpd_pipe_callback callback, gpointer data, const char *command, ...);
+
+struct irmpc_mpd_pipe_request;
+
+struct irmpc_mpd_pipe_request * irmpc_mpd_pipe_list_new  (irmpc_mpd_pipe_callback callback, gpointer data);
+void                            irmpc_mpd_pipe_list_add  (struct irmpc_mpd_pipe_request *request, const char *command, ...);
+bool                            irmpc_mpd_pipe_list_send (struct irmpc_mpd_pipe_request *request);
+
+void         irmpc_mpd_pipe_barrier   (irmpc_mpd_pipe_barrier_callback callback, gpointer data);
+bool         irmpc_mpd_pipe_connect   ();
+void         irmpc_mpd_pipe_keepalive ();
+void         irmpc_mpd_pipe_set_host  (const char *host);
+void         irmpc_mpd_pipe_set_partition (const char *partition);
+unsigned int irmpc_mpd_pipe_pending ();
+void         irmpc_mpd_pipe_free    ();
+
+#endif
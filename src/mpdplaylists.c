@@ -0,0 +1,210 @@
+#include "mpdplaylists.h"
+#include "options.h"
+#include "playlist.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* numbers assigned to discovered stored playlists (name -> number) of executor thread's target */
+static __thread GHashTable *playlists_auto  = NULL;
+static __thread gchar      *playlists_cache = NULL;
+
+/* cache file: configured or in user cache dir - own one per room */
+static gchar * irmpc_mpd_playlists_cache_path (const char *room)
+{
+    gchar *path;
+
+    if (irmpc_options.mpd_playlist_cache != NULL) {
+        path = g_strdup (irmpc_options.mpd_playlist_cache);
+    } else {
+        path = g_build_filename (g_get_user_cache_dir (), "irmpc", "playlists", NULL);
+    }
+
+    if (room != NULL) {
+        gchar *room_path = g_strdup_printf ("%s-%s", path, room);
+        g_free (path);
+        path = room_path;
+    }
+
+    return path;
+}
+
+/* add discovered playlist unless name or number is taken by configured ones */
+static bool irmpc_mpd_playlists_add (unsigned int number, const char *name)
+{
+    unsigned int existing;
+
+    if (irmpc_playlist_number (name, &existing)) return false;
+    if (irmpc_playlist_get (number) != NULL)     return false;
+
+    irmpc_playlist_add (number, name, false);
+
+    if (playlists_auto == NULL) {
+        playlists_auto = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+    g_hash_table_insert (playlists_auto, g_strdup (name), GUINT_TO_POINTER (number));
+
+    return true;
+}
+
+/* read numbers assigned earlier - usable before mpd is connected */
+void irmpc_mpd_playlists_load_cache (const char *room)
+{
+    g_free (playlists_cache);
+    playlists_cache = irmpc_mpd_playlists_cache_path (room);
+
+    const gchar *path     = playlists_cache;
+    GKeyFile    *key_file = g_key_file_new ();
+    GError      *error    = NULL;
+
+    if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error)) {
+        if (irmpc_options.debug) {
+            printf ("INFO: no playlist cache loaded from %s: %s\n", path, error->message);
+        }
+        g_error_free (error);
+        g_key_file_free (key_file);
+        return;
+    }
+
+    gsize   count = 0;
+    gchar **keys  = g_key_file_get_keys (key_file, "playlists", &count, NULL);
+
+    for (gsize i = 0; (keys != NULL) && (i < count); i++) {
+        char     *endptr;
+        long int  number = strtol (keys[i], &endptr, 10);
+        if ((keys[i][0] == '\0') || (*endptr != '\0') || (number < 0)) continue;
+
+        gchar *name = g_key_file_get_string (key_file, "playlists", keys[i], NULL);
+        if (name == NULL) continue;
+
+        irmpc_mpd_playlists_add (number, name);
+        g_free (name);
+    }
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: loaded %u cached playlists from %s\n", (playlists_auto != NULL) ? g_hash_table_size (playlists_auto) : 0, path);
+    }
+
+    g_strfreev (keys);
+    g_key_file_free (key_file);
+}
+
+/* write assigned numbers to cache file */
+static void irmpc_mpd_playlists_save_cache ()
+{
+    const gchar *path     = playlists_cache;
+    gchar       *dir      = g_path_get_dirname (path);
+    GKeyFile    *key_file = g_key_file_new ();
+    GError      *error    = NULL;
+
+    GHashTableIter iter;
+    gpointer       name, number;
+
+    g_hash_table_iter_init (&iter, playlists_auto);
+    while (g_hash_table_iter_next (&iter, &name, &number)) {
+        char number_str [16];
+        snprintf (number_str, sizeof (number_str), "%02u", GPOINTER_TO_UINT (number));
+        g_key_file_set_string (key_file, "playlists", number_str, (const gchar *) name);
+    }
+
+    g_mkdir_with_parents (dir, 0755);
+
+    if (!g_key_file_save_to_file (key_file, path, &error)) {
+        fprintf (stderr, "WARNING: failed to write playlist cache %s: %s\n", path, error->message);
+        g_error_free (error);
+    }
+
+    g_key_file_free (key_file);
+    g_free (dir);
+}
+
+static gint irmpc_mpd_playlists_cmp_func (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+/* list stored playlists: number new ones, drop removed ones, update cache if changed */
+bool irmpc_mpd_playlists_sync (struct mpd_connection *connection)
+{
+    if (!mpd_send_list_playlists (connection)) return false;
+
+    GHashTable *present = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    GPtrArray  *names   = g_ptr_array_new ();
+
+    struct mpd_playlist *playlist;
+    while ((playlist = mpd_recv_playlist (connection)) != NULL) {
+        gchar *name = g_strdup (mpd_playlist_get_path (playlist));
+        g_hash_table_add (present, name);
+        g_ptr_array_add (names, name);
+        mpd_playlist_free (playlist);
+    }
+
+    if ((mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) || (!mpd_response_finish (connection))) {
+        fprintf (stderr, "ERROR: listing stored playlists failed: %s\n", mpd_connection_get_error_message (connection));
+        g_ptr_array_free (names, true);
+        g_hash_table_destroy (present);
+        return false;
+    }
+
+    bool changed = false;
+
+    /* removed playlists */
+    if (playlists_auto != NULL) {
+        GHashTableIter iter;
+        gpointer       name, number;
+
+        g_hash_table_iter_init (&iter, playlists_auto);
+        while (g_hash_table_iter_next (&iter, &name, &number)) {
+            if (g_hash_table_contains (present, name)) continue;
+
+            if (irmpc_options.debug) {
+                printf ("INFO: stored playlist %s removed\n", (const char *) name);
+            }
+
+            irmpc_playlist_remove (GPOINTER_TO_UINT (number));
+            g_hash_table_iter_remove (&iter);
+            changed = true;
+        }
+    }
+
+    /* new playlists - numbered in name order */
+    g_ptr_array_sort (names, irmpc_mpd_playlists_cmp_func);
+
+    for (unsigned int i = 0; i < names->len; i++) {
+        const char  *name = g_ptr_array_index (names, i);
+        unsigned int number;
+
+        if (irmpc_playlist_number (name, &number)) continue;
+
+        number = irmpc_playlist_next_free ();
+
+        if (irmpc_mpd_playlists_add (number, name)) {
+            if (irmpc_options.verbose) {
+                printf ("INFO: stored playlist %s added as %02u\n", name, number);
+            }
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        irmpc_mpd_playlists_save_cache ();
+    }
+
+    g_ptr_array_free (names, true);
+    g_hash_table_destroy (present);
+
+    return true;
+}
+
+void irmpc_mpd_playlists_free ()
+{
+    if (playlists_auto != NULL) {
+        g_hash_table_destroy (playlists_auto);
+        playlists_auto = NULL;
+    }
+
+    g_free (playlists_cache);
+    playlists_cache = NULL;
+}
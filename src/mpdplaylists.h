@@ -0,0 +1,11 @@
+#ifndef __mpdplaylists_h__
+#define __mpdplaylists_h__
+
+#include <stdbool.h>
+#include <mpd/client.h>
+
+void irmpc_mpd_playlists_load_cache (const char *room);
+bool irmpc_mpd_playlists_sync       (struct mpd_connection *connection);
+void irmpc_mpd_playlists_free       ();
+
+#endif
@@ -0,0 +1,323 @@
+#include "mpdqueue.h"
+#include "options.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* songs per listing request of full sync - keeps responses below mpd's max_output_buffer_size */
+#define IRMPC_MPD_QUEUE_RANGE 1000
+
+/* all state per executor thread - mirrors queue of its target */
+/* entries by position */
+static __thread GArray       *queue_entries = NULL;
+/* album tag by song id for all songs seen since last full listing */
+static __thread GHashTable   *queue_albums  = NULL;
+/* memory for (deduplicated) tag strings */
+static __thread GStringChunk *queue_strings = NULL;
+/* queue version the mirror corresponds to */
+static __thread bool          queue_valid   = false;
+static __thread unsigned int  queue_version = 0;
+
+/* album index: start position of each run of songs with same album tag
+ * and run number of each position - rebuilt lazily after mirror changes */
+static __thread GArray       *album_starts  = NULL;
+static __thread GArray       *album_runs    = NULL;
+static __thread bool          album_valid   = false;
+
+/* start empty album index */
+static void irmpc_mpd_queue_album_reset ()
+{
+    if (album_starts == NULL) {
+        album_starts = g_array_new (false, false, sizeof (unsigned int));
+        album_runs   = g_array_new (false, false, sizeof (unsigned int));
+    }
+    g_array_set_size (album_starts, 0);
+    g_array_set_size (album_runs,   0);
+}
+
+/* add next position to album index - all positions before are indexed */
+static void irmpc_mpd_queue_album_append (unsigned int position)
+{
+    const char *album      = g_array_index (queue_entries, struct irmpc_mpd_queue_entry, position).album;
+    const char *last_album = (position > 0) ? g_array_index (queue_entries, struct irmpc_mpd_queue_entry, position - 1).album : NULL;
+
+    /* tags are deduplicated: same album <=> same pointer
+     * songs without album tag always start a new run */
+    if ((position == 0) || (album == NULL) || (album != last_album)) {
+        g_array_append_val (album_starts, position);
+    }
+
+    unsigned int run = album_starts->len - 1;
+    g_array_append_val (album_runs, run);
+}
+
+/* build album run index from mirror */
+static void irmpc_mpd_queue_album_index ()
+{
+    if (album_valid) return;
+
+    unsigned int length = irmpc_mpd_queue_length ();
+
+    irmpc_mpd_queue_album_reset ();
+    for (unsigned int position = 0; position < length; position++) {
+        irmpc_mpd_queue_album_append (position);
+    }
+
+    album_valid = true;
+
+    if (irmpc_options.debug) {
+        printf ("INFO: album index built - %u albums in %u songs\n", album_starts->len, length);
+    }
+}
+
+/* report error of last request on connection */
+static bool irmpc_mpd_queue_error (struct mpd_connection *connection, const char *what)
+{
+    if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+        fprintf (stderr, "ERROR: %s: %s\n", what, mpd_connection_get_error_message (connection));
+        irmpc_mpd_queue_invalidate ();
+        return true;
+    }
+    return false;
+}
+
+/* remember tags of received song and put it at its position */
+static void irmpc_mpd_queue_store_song (const struct mpd_song *song)
+{
+    const char  *album    = mpd_song_get_tag (song, MPD_TAG_ALBUM, 0);
+    unsigned int position = mpd_song_get_pos (song);
+
+    struct irmpc_mpd_queue_entry entry = {
+        .id    = mpd_song_get_id (song),
+        .album = ((album != NULL) ? g_string_chunk_insert_const (queue_strings, album) : NULL)
+    };
+
+    g_hash_table_insert (queue_albums, GUINT_TO_POINTER (entry.id), (gpointer) entry.album);
+
+    if (position >= queue_entries->len) {
+        g_array_set_size (queue_entries, position + 1);
+    }
+    g_array_index (queue_entries, struct irmpc_mpd_queue_entry, position) = entry;
+}
+
+/* read complete queue with tags in ranges - album index is built as ranges arrive */
+static bool irmpc_mpd_queue_sync_full (struct mpd_connection *connection, unsigned int length)
+{
+    irmpc_mpd_queue_free ();
+
+    queue_entries = g_array_sized_new (false, true, sizeof (struct irmpc_mpd_queue_entry), length);
+    queue_albums  = g_hash_table_new (g_direct_hash, g_direct_equal);
+    queue_strings = g_string_chunk_new (4096);
+
+    g_array_set_size (queue_entries, length);
+    irmpc_mpd_queue_album_reset ();
+
+    for (unsigned int start = 0; start < length; start += IRMPC_MPD_QUEUE_RANGE) {
+        unsigned int end = MIN (start + IRMPC_MPD_QUEUE_RANGE, length);
+
+        if (!mpd_send_list_queue_range_meta (connection, start, end)) {
+            irmpc_mpd_queue_error (connection, "listing queue");
+            return false;
+        }
+
+        struct mpd_song *song;
+        while ((song = mpd_recv_song (connection)) != NULL) {
+            if (mpd_song_get_pos (song) < length) {
+                irmpc_mpd_queue_store_song (song);
+            }
+            mpd_song_free (song);
+        }
+
+        if (!mpd_response_finish (connection)) {
+            irmpc_mpd_queue_error (connection, "listing queue");
+            return false;
+        }
+
+        for (unsigned int position = start; position < end; position++) {
+            irmpc_mpd_queue_album_append (position);
+        }
+    }
+
+    album_valid = true;
+
+    return true;
+}
+
+/* apply changes since mirrored version - ids and positions only, tags from known ids */
+static bool irmpc_mpd_queue_sync_changes (struct mpd_connection *connection, unsigned int length, bool *complete)
+{
+    *complete = true;
+
+    if (!mpd_send_queue_changes_brief (connection, queue_version)) {
+        irmpc_mpd_queue_error (connection, "reading queue changes");
+        return false;
+    }
+
+    g_array_set_size (queue_entries, length);
+
+    unsigned int position;
+    unsigned int id;
+    while (mpd_recv_queue_change_brief (connection, &position, &id)) {
+        if (position >= length) continue;
+
+        struct irmpc_mpd_queue_entry *entry = &g_array_index (queue_entries, struct irmpc_mpd_queue_entry, position);
+        gpointer album;
+
+        entry->id = id;
+        if (g_hash_table_lookup_extended (queue_albums, GUINT_TO_POINTER (id), NULL, &album)) {
+            entry->album = (const char *) album;
+        } else {
+            /* new song - tags need to be read */
+            entry->album = NULL;
+            *complete    = false;
+        }
+    }
+
+    if (!mpd_response_finish (connection)) {
+        irmpc_mpd_queue_error (connection, "reading queue changes");
+        return false;
+    }
+
+    return true;
+}
+
+/* read changed songs since mirrored version including tags */
+static bool irmpc_mpd_queue_sync_changes_meta (struct mpd_connection *connection)
+{
+    if (!mpd_send_queue_changes_meta (connection, queue_version)) {
+        irmpc_mpd_queue_error (connection, "reading queue changes");
+        return false;
+    }
+
+    unsigned int length = queue_entries->len;
+
+    struct mpd_song *song;
+    while ((song = mpd_recv_song (connection)) != NULL) {
+        if (mpd_song_get_pos (song) < length) {
+            irmpc_mpd_queue_store_song (song);
+        }
+        mpd_song_free (song);
+    }
+
+    if (!mpd_response_finish (connection)) {
+        irmpc_mpd_queue_error (connection, "reading queue changes");
+        return false;
+    }
+
+    return true;
+}
+
+/* bring mirror up to given queue version - connection must not be idle */
+bool irmpc_mpd_queue_sync (struct mpd_connection *connection, unsigned int version, unsigned int length)
+{
+    if (queue_valid && (queue_version == version) && (queue_entries->len == length)) return true;
+
+    bool success;
+
+    if (!queue_valid) {
+        success = irmpc_mpd_queue_sync_full (connection, length);
+    } else {
+        bool complete;
+        album_valid = false;
+        success = irmpc_mpd_queue_sync_changes (connection, length, &complete);
+        if (success && (!complete)) {
+            success = irmpc_mpd_queue_sync_changes_meta (connection);
+        }
+    }
+
+    queue_valid   = success;
+    queue_version = version;
+    album_valid   = (album_valid && success);
+
+    if (irmpc_options.debug) {
+        printf ("INFO: queue mirror %s - version: %u, length: %u\n", (success ? "updated" : "invalid"), version, length);
+    }
+
+    return success;
+}
+
+/* check whether mirror corresponds to given queue version */
+bool irmpc_mpd_queue_valid (unsigned int version)
+{
+    return (queue_valid && (queue_version == version));
+}
+
+/* number of mirrored entries */
+unsigned int irmpc_mpd_queue_length ()
+{
+    if (queue_entries == NULL) return 0;
+    return queue_entries->len;
+}
+
+/* entry at position or NULL */
+const struct irmpc_mpd_queue_entry * irmpc_mpd_queue_get (unsigned int position)
+{
+    if ((queue_entries == NULL) || (position >= queue_entries->len)) return NULL;
+    return &g_array_index (queue_entries, struct irmpc_mpd_queue_entry, position);
+}
+
+/* apply own delete command to mirror ahead of server notification */
+void irmpc_mpd_queue_delete (unsigned int position)
+{
+    if ((queue_entries == NULL) || (position >= queue_entries->len)) return;
+    g_array_remove_index (queue_entries, position);
+    album_valid = false;
+}
+
+/* number of albums (runs of same album tag) in queue */
+unsigned int irmpc_mpd_queue_album_count ()
+{
+    irmpc_mpd_queue_album_index ();
+    return album_starts->len;
+}
+
+/* album run number of song at position */
+unsigned int irmpc_mpd_queue_album_of (unsigned int position)
+{
+    irmpc_mpd_queue_album_index ();
+    if (position >= album_runs->len) return 0;
+    return g_array_index (album_runs, unsigned int, position);
+}
+
+/* position of first song of album run */
+unsigned int irmpc_mpd_queue_album_start (unsigned int album)
+{
+    irmpc_mpd_queue_album_index ();
+    if (album >= album_starts->len) return 0;
+    return g_array_index (album_starts, unsigned int, album);
+}
+
+/* force full listing on next sync */
+void irmpc_mpd_queue_invalidate ()
+{
+    queue_valid = false;
+    album_valid = false;
+}
+
+/* free mirror */
+void irmpc_mpd_queue_free ()
+{
+    queue_valid = false;
+    album_valid = false;
+
+    if (album_starts != NULL) {
+        g_array_free (album_starts, true);
+        g_array_free (album_runs,   true);
+        album_starts = NULL;
+        album_runs   = NULL;
+    }
+
+    if (queue_entries != NULL) {
+        g_array_free (queue_entries, true);
+        queue_entries = NULL;
+    }
+    if (queue_albums != NULL) {
+        g_hash_table_destroy (queue_albums);
+        queue_albums = NULL;
+    }
+    if (queue_strings != NULL) {
+        g_string_chunk_free (queue_strings);
+        queue_strings = NULL;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef __mpdqueue_h__
+#define __mpdqueue_h__
+
+#include <stdbool.h>
+#include <mpd/client.h>
+
+/* mirrored queue entry */
+struct irmpc_mpd_queue_entry {
+    unsigned int  id;
+    const char   *album;
+};
+
+bool         irmpc_mpd_queue_sync       (struct mpd_connection *connection, unsigned int version, unsigned int length);
+bool         irmpc_mpd_queue_valid      (unsigned int version);
+unsigned int irmpc_mpd_queue_length     ();
+const struct irmpc_mpd_queue_entry * irmpc_mpd_queue_get (unsigned int position);
+void         irmpc_mpd_queue_delete     (unsigned int position);
+unsigned int irmpc_mpd_queue_album_count ();
+unsigned int irmpc_mpd_queue_album_of    (unsigned int position);
+unsigned int irmpc_mpd_queue_album_start (unsigned int album);
+void         irmpc_mpd_queue_invalidate ();
+void         irmpc_mpd_queue_free       ();
+
+#endif
@@ -6,68 +6,151 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct _irmpc_options irmpc_options = {
-    .config_file       = NULL,
-    .mpd_hostname      = "localhost",
-    .mpd_password      = NULL,
-    .mpd_port          = 6600,
-    .mpd_maxtries      = 2,
-    .mpd_update_amount = 2,
-    .volume_step       = 2,
-    .lirc_config       = NULL,
-    .lircd_tries       = 5,
-    .lirc_key_timespan = 2,
-    .power_command     = NULL,
-    .power_amount      = 2,
-    .progname          = "irmpc",
-    .verbose           = false,
-    .debug             = false
+/* options snapshot with reference count
+ * strings are owned unless set by command line parsing (initial snapshot) */
+struct irmpc_options_snapshot {
+    struct _irmpc_options options;
+    gint                  refs;
+    bool                  owned;
+};
+
+static struct irmpc_options_snapshot options_initial = {
+    .options = {
+        .config_file          = NULL,
+        .mpd_hostname         = "localhost",
+        .mpd_password         = NULL,
+        .mpd_port             = 6600,
+        .mpd_maxtries         = 2,
+        .mpd_keepalive        = 30,
+        .mpd_update_amount    = 2,
+        .mpd_partitions       = 0,
+        .mpd_autoplaylists    = 0,
+        .mpd_playlist_cache   = NULL,
+        .mpd_rooms            = NULL,
+        .mpd_room_hosts       = NULL,
+        .volume_step          = 2,
+#ifndef DEBUG_NO_LIRC
+        .input                = "lirc",
+#else
+        .input                = "stdin",
+#endif
+        .input_devices        = "/dev/input/event*",
+        .trace_record         = NULL,
+        .trace_replay         = NULL,
+        .trace_replay_speed   = 100,
+        .lirc_config          = NULL,
+        .lircd_tries          = 5,
+        .lirc_key_timespan    = 2,
+        .lirc_key_timespan_ms = 0,
+        .lirc_longpress_ms    = 0,
+        .lirc_skip_window     = 300,
+        .power_command        = NULL,
+        .power_amount         = 2,
+        .watch_config         = 0,
+        .control_socket       = NULL,
+        .progname             = "irmpc",
+        .verbose              = false,
+        .debug                = false
+    },
+    .refs  = 1,
+    .owned = false
+};
+
+/* published snapshot - replaced as a whole on reload by main thread */
+static struct irmpc_options_snapshot *options_current = &options_initial;
+/* snapshot used by this thread instead of published one (executor threads) */
+static __thread struct irmpc_options_snapshot *options_local = NULL;
+
+/* string members copied + freed with snapshot */
+static const glong options_strings [] = {
+    G_STRUCT_OFFSET (struct _irmpc_options, config_file),
+    G_STRUCT_OFFSET (struct _irmpc_options, mpd_hostname),
+    G_STRUCT_OFFSET (struct _irmpc_options, mpd_password),
+    G_STRUCT_OFFSET (struct _irmpc_options, mpd_playlist_cache),
+    G_STRUCT_OFFSET (struct _irmpc_options, input),
+    G_STRUCT_OFFSET (struct _irmpc_options, input_devices),
+    G_STRUCT_OFFSET (struct _irmpc_options, trace_record),
+    G_STRUCT_OFFSET (struct _irmpc_options, trace_replay),
+    G_STRUCT_OFFSET (struct _irmpc_options, lirc_config),
+    G_STRUCT_OFFSET (struct _irmpc_options, power_command),
+    G_STRUCT_OFFSET (struct _irmpc_options, control_socket),
+    G_STRUCT_OFFSET (struct _irmpc_options, progname)
 };
 
 struct option_file_data {
     const gchar *group_name;
     const gchar *key_name;
     GOptionArg   arg;
-    gpointer     arg_data;
+    glong        arg_offset;
 };
 
 static GOptionEntry option_entries [] = {
-    {"config",       'c', 0, G_OPTION_ARG_FILENAME, &(irmpc_options.config_file),       "Configuration file",                                            "filename"},
-    {"hostname",     'H', 0, G_OPTION_ARG_STRING,   &(irmpc_options.mpd_hostname),      "Hostname of host running mpd - default: localhost",             "host"},
-    {"password",     'p', 0, G_OPTION_ARG_STRING,   &(irmpc_options.mpd_password),      "Password of mpd",                                               "password"},
-    {"port",         'P', 0, G_OPTION_ARG_INT,      &(irmpc_options.mpd_port),          "Port of mpd - default: port=6600",                              "port"},
-    {"maxtries",     'm', 0, G_OPTION_ARG_INT,      &(irmpc_options.mpd_maxtries),      "Maximum tries for sending mpd commands",                        "n"},
-    {"updaterepeat", 'u', 0, G_OPTION_ARG_INT,      &(irmpc_options.mpd_update_amount), "Amount of times playlist update button needs to be pressed",    "n"},
-    {"volumestep",   's', 0, G_OPTION_ARG_INT,      &(irmpc_options.volume_step),       "Step in percent for volume up/down",                            "step"},
-    {"lircconfig",   'l', 0, G_OPTION_ARG_FILENAME, &(irmpc_options.lirc_config),       "Configuration file for lirc commands",                          "filename"},
-    {"keytimespan",  't', 0, G_OPTION_ARG_INT,      &(irmpc_options.lirc_key_timespan), "Maximum time in seconds between keys of multiple key commands", "span"},
-    {"powercmd",     'C', 0, G_OPTION_ARG_STRING,   &(irmpc_options.power_command),     "System command to execute when poweroff button is pressed",     "command"},
-    {"powerrepeat",  'r', 0, G_OPTION_ARG_INT,      &(irmpc_options.power_amount),      "Amount of times power button needs to be pressed",              "amount"},
-    {"verbose",      'v', 0, 0,                     &(irmpc_options.verbose),           "Set to verbose",                                                NULL},
-    {"debug",        'd', 0, 0,                     &(irmpc_options.debug),             "Activate debug output",                                         NULL},
+    {"config",         'c', 0, G_OPTION_ARG_FILENAME, &(options_initial.options.config_file),          "Configuration file",                                                               "filename"},
+    {"hostname",       'H', 0, G_OPTION_ARG_STRING,   &(options_initial.options.mpd_hostname),         "Hostname of host running mpd, fallbacks separated by ',' - default: localhost",    "host"},
+    {"password",       'p', 0, G_OPTION_ARG_STRING,   &(options_initial.options.mpd_password),         "Password of mpd",                                                                  "password"},
+    {"port",           'P', 0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_port),             "Port of mpd - default: port=6600",                                                 "port"},
+    {"maxtries",       'm', 0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_maxtries),         "Maximum tries for sending mpd commands",                                           "n"},
+    {"keepalive",      0,   0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_keepalive),        "Interval in seconds for checking mpd connections (0: off)",                        "s"},
+    {"updaterepeat",   'u', 0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_update_amount),    "Amount of times playlist update button needs to be pressed",                       "n"},
+    {"partitions",     0,   0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_partitions),       "Playlists kept loaded in own mpd partitions (0: off)",                             "n"},
+    {"autoplaylists",  0,   0, G_OPTION_ARG_INT,      &(options_initial.options.mpd_autoplaylists),    "Number stored mpd playlists automatically (0: off)",                               "0/1"},
+    {"playlistcache",  0,   0, G_OPTION_ARG_FILENAME, &(options_initial.options.mpd_playlist_cache),   "Cache file for numbers of stored mpd playlists",                                   "filename"},
+    {"volumestep",     's', 0, G_OPTION_ARG_INT,      &(options_initial.options.volume_step),          "Step in percent for volume up/down",                                               "step"},
+    {"input",          'i', 0, G_OPTION_ARG_STRING,   &(options_initial.options.input),                "Source of key presses: lirc, evdev or stdin",                                      "source"},
+    {"inputdevices",   0,   0, G_OPTION_ARG_STRING,   &(options_initial.options.input_devices),        "Input devices for evdev, patterns separated by ',' - default: /dev/input/event*",  "paths"},
+    {"record",         0,   0, G_OPTION_ARG_FILENAME, &(options_initial.options.trace_record),         "Record decoded commands with timestamps to trace file",                            "filename"},
+    {"replay",         0,   0, G_OPTION_ARG_FILENAME, &(options_initial.options.trace_replay),         "Trace file to replay with input replay",                                           "filename"},
+    {"replayspeed",    0,   0, G_OPTION_ARG_INT,      &(options_initial.options.trace_replay_speed),   "Replay speed in percent of recorded timing (0: as fast as possible)",              "percent"},
+    {"lircconfig",     'l', 0, G_OPTION_ARG_FILENAME, &(options_initial.options.lirc_config),          "Configuration file for lirc commands",                                             "filename"},
+    {"keytimespan",    't', 0, G_OPTION_ARG_INT,      &(options_initial.options.lirc_key_timespan),    "Maximum time in seconds between keys of multiple key commands",                    "span"},
+    {"keytimespan-ms", 0,   0, G_OPTION_ARG_INT,      &(options_initial.options.lirc_key_timespan_ms), "Maximum time in ms between keys of multiple key commands (overrides keytimespan)", "ms"},
+    {"longpress",      0,   0, G_OPTION_ARG_INT,      &(options_initial.options.lirc_longpress_ms),    "Time in ms a key held counts as all needed repeated presses (0: off)",             "ms"},
+    {"skipwindow",     0,   0, G_OPTION_ARG_INT,      &(options_initial.options.lirc_skip_window),     "Time in ms further next/prev presses are folded into one jump (0: off)",           "ms"},
+    {"powercmd",       'C', 0, G_OPTION_ARG_STRING,   &(options_initial.options.power_command),        "System command to execute when poweroff button is pressed",                        "command"},
+    {"powerrepeat",    'r', 0, G_OPTION_ARG_INT,      &(options_initial.options.power_amount),         "Amount of times power button needs to be pressed",                                 "amount"},
+    {"watchconfig",    0,   0, G_OPTION_ARG_INT,      &(options_initial.options.watch_config),         "Reload config + lirc config when changed (0: only on SIGHUP)",                     "0/1"},
+    {"controlsocket",  0,   0, G_OPTION_ARG_FILENAME, &(options_initial.options.control_socket),       "Unix socket accepting command lines like m:next (default: off)",                   "path"},
+    {"verbose",        'v', 0, 0,                     &(options_initial.options.verbose),              "Set to verbose",                                                                   NULL},
+    {"debug",          'd', 0, 0,                     &(options_initial.options.debug),                "Activate debug output",                                                            NULL},
     {NULL}
 };
 
 static struct option_file_data cfg_file_entries [] = {
-    {"mpd",    "hostname",     G_OPTION_ARG_STRING,   &(irmpc_options.mpd_hostname)},
-    {"mpd",    "password",     G_OPTION_ARG_STRING,   &(irmpc_options.mpd_password)},
-    {"mpd",    "port",         G_OPTION_ARG_INT,      &(irmpc_options.mpd_port)},
-    {"mpd",    "maxtries",     G_OPTION_ARG_INT,      &(irmpc_options.mpd_maxtries)},
-    {"mpd",    "updaterepeat", G_OPTION_ARG_INT,      &(irmpc_options.mpd_update_amount)},
-    {"mpd",    "volumestep",   G_OPTION_ARG_INT,      &(irmpc_options.volume_step)},
-    {"lirc",   "lircconfig",   G_OPTION_ARG_FILENAME, &(irmpc_options.lirc_config)},
-    {"lirc",   "keytimespan",  G_OPTION_ARG_INT,      &(irmpc_options.lirc_key_timespan)},
-    {"system", "powercmd",     G_OPTION_ARG_STRING,   &(irmpc_options.power_command)},
-    {"system", "powerrepeat",  G_OPTION_ARG_INT,      &(irmpc_options.power_amount)},
+    {"mpd",    "hostname",       G_OPTION_ARG_STRING,   G_STRUCT_OFFSET (struct _irmpc_options, mpd_hostname)},
+    {"mpd",    "password",       G_OPTION_ARG_STRING,   G_STRUCT_OFFSET (struct _irmpc_options, mpd_password)},
+    {"mpd",    "port",           G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_port)},
+    {"mpd",    "maxtries",       G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_maxtries)},
+    {"mpd",    "keepalive",      G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_keepalive)},
+    {"mpd",    "updaterepeat",   G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_update_amount)},
+    {"mpd",    "partitions",     G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_partitions)},
+    {"mpd",    "autoplaylists",  G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, mpd_autoplaylists)},
+    {"mpd",    "playlistcache",  G_OPTION_ARG_FILENAME, G_STRUCT_OFFSET (struct _irmpc_options, mpd_playlist_cache)},
+    {"mpd",    "volumestep",     G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, volume_step)},
+    {"lirc",   "input",          G_OPTION_ARG_STRING,   G_STRUCT_OFFSET (struct _irmpc_options, input)},
+    {"lirc",   "inputdevices",   G_OPTION_ARG_STRING,   G_STRUCT_OFFSET (struct _irmpc_options, input_devices)},
+    {"lirc",   "record",         G_OPTION_ARG_FILENAME, G_STRUCT_OFFSET (struct _irmpc_options, trace_record)},
+    {"lirc",   "replay",         G_OPTION_ARG_FILENAME, G_STRUCT_OFFSET (struct _irmpc_options, trace_replay)},
+    {"lirc",   "replayspeed",    G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, trace_replay_speed)},
+    {"lirc",   "lircconfig",     G_OPTION_ARG_FILENAME, G_STRUCT_OFFSET (struct _irmpc_options, lirc_config)},
+    {"lirc",   "keytimespan",    G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, lirc_key_timespan)},
+    {"lirc",   "keytimespan_ms", G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, lirc_key_timespan_ms)},
+    {"lirc",   "longpress_ms",   G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, lirc_longpress_ms)},
+    {"lirc",   "skipwindow",     G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, lirc_skip_window)},
+    {"system", "powercmd",       G_OPTION_ARG_STRING,   G_STRUCT_OFFSET (struct _irmpc_options, power_command)},
+    {"system", "powerrepeat",    G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, power_amount)},
+    {"system", "watchconfig",    G_OPTION_ARG_INT,      G_STRUCT_OFFSET (struct _irmpc_options, watch_config)},
+    {"system", "controlsocket",  G_OPTION_ARG_FILENAME, G_STRUCT_OFFSET (struct _irmpc_options, control_socket)},
     {NULL}
 };
 
-static bool irmpc_options_from_file ()
+/* read options + playlists from config file into given options/table
+ * owned: replaced strings belong to options and are freed */
+static bool irmpc_options_from_file (struct _irmpc_options *options, bool owned, struct irmpc_playlist_table *table)
 {
     GError   *error    = NULL;
     GKeyFile *key_file = g_key_file_new ();
 
-    if (!g_key_file_load_from_file (key_file, irmpc_options.config_file, G_KEY_FILE_NONE, &error)) {
+    if (!g_key_file_load_from_file (key_file, options->config_file, G_KEY_FILE_NONE, &error)) {
         fprintf (stderr, "Error parsing config file: %s\n", error->message);
         g_error_free (error);
         return false;
@@ -80,12 +163,12 @@ static bool irmpc_options_from_file ()
             gint   tempint;
             tempint = g_key_file_get_integer (key_file, entry->group_name, entry->key_name, &error);
             if (error == NULL) {
-                int *targetint = (int *) entry->arg_data;
+                int *targetint = (int *) G_STRUCT_MEMBER_P (options, entry->arg_offset);
                 *targetint = tempint;
             } else {
                 if ((error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) && (error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
                     g_key_file_free (key_file);
-                    fprintf (stderr, "Error parsing config file %s: %s\n", irmpc_options.config_file, error->message);
+                    fprintf (stderr, "Error parsing config file %s: %s\n", options->config_file, error->message);
                     g_error_free (error);
                     return false;
                 }
@@ -97,7 +180,8 @@ static bool irmpc_options_from_file ()
                 printf ("INFO: parsed string %s for option %s\n", tempstr, entry->key_name);
             }
             if (tempstr != NULL) {
-                gchar **targetstr = (gchar **) entry->arg_data;
+                gchar **targetstr = (gchar **) G_STRUCT_MEMBER_P (options, entry->arg_offset);
+                if (owned) g_free (*targetstr);
                 *targetstr = tempstr;
             }
         }
@@ -129,7 +213,7 @@ static bool irmpc_options_from_file ()
                     }
                 }
 
-                irmpc_playlist_add (number, entryname, entryrand);
+                irmpc_playlist_table_add (table, number, entryname, entryrand);
             }
 
             g_strfreev (entrylist);
@@ -138,6 +222,22 @@ static bool irmpc_options_from_file ()
         g_strfreev (tempstrlist);
     }
 
+    /* rooms: name=hosts */
+    gchar **rooms = g_key_file_get_keys (key_file, "rooms", &listlen, NULL);
+    if ((rooms != NULL) && (listlen > 0)) {
+        if (owned) {
+            g_strfreev (options->mpd_rooms);
+            g_strfreev (options->mpd_room_hosts);
+        }
+        options->mpd_rooms      = rooms;
+        options->mpd_room_hosts = g_new0 (gchar *, listlen + 1);
+        for (int i = 0; i < listlen; i++) {
+            options->mpd_room_hosts[i] = g_key_file_get_string (key_file, "rooms", rooms[i], NULL);
+        }
+    } else {
+        g_strfreev (rooms);
+    }
+
     /* free */
     g_key_file_free (key_file);
     if (error != NULL) {
@@ -148,64 +248,101 @@ static bool irmpc_options_from_file ()
 }
 
 /* option checking */
-static bool options_check ()
+static bool options_check (struct _irmpc_options *options, struct irmpc_playlist_table *table)
 {
-    if (irmpc_options.config_file != NULL) {
-        if (irmpc_options.debug) {
-            printf ("config-file: %s\n", irmpc_options.config_file);
+    if (options->config_file != NULL) {
+        if (options->debug) {
+            printf ("config-file: %s\n", options->config_file);
         }
     }
-    if (irmpc_options.mpd_hostname == NULL) {
+    if (options->mpd_hostname == NULL) {
         fprintf (stderr, "ERROR: no hostname specified\n");
         return false;
     } else {
-        if (irmpc_options.debug) {
-            printf ("hostname: %s\n", irmpc_options.mpd_hostname);
+        if (options->debug) {
+            printf ("hostname: %s\n", options->mpd_hostname);
         }
     }
-    if (irmpc_options.mpd_port >= (1 << 16)) {
+    if (options->mpd_port >= (1 << 16)) {
         fprintf (stderr, "ERROR: port needs to be in range 0 ... %d\n", (1 << 16));
         return false;
     } else {
-        if (irmpc_options.debug) {
-            printf ("port: %d\n", irmpc_options.mpd_port);
+        if (options->debug) {
+            printf ("port: %d\n", options->mpd_port);
         }
     }
-    if (irmpc_options.mpd_password != NULL) {
-        if (irmpc_options.debug) {
-            printf ("password: %s\n", irmpc_options.mpd_password);
+    if (options->mpd_password != NULL) {
+        if (options->debug) {
+            printf ("password: %s\n", options->mpd_password);
         }
     }
-    if (irmpc_options.debug) {
-        printf ("mpd-maxtries: %d\n", irmpc_options.mpd_maxtries);
+    if (options->debug) {
+        printf ("mpd-maxtries: %d\n", options->mpd_maxtries);
+        printf ("mpd-keepalive: %d s\n", options->mpd_keepalive);
+        printf ("mpd-partitions: %d\n", options->mpd_partitions);
+        printf ("mpd-autoplaylists: %d\n", options->mpd_autoplaylists);
+        if (options->mpd_playlist_cache != NULL) {
+            printf ("mpd-playlistcache: %s\n", options->mpd_playlist_cache);
+        }
+        for (int i = 0; (options->mpd_rooms != NULL) && (options->mpd_rooms[i] != NULL); i++) {
+            printf ("mpd-room: %s=%s\n", options->mpd_rooms[i], options->mpd_room_hosts[i]);
+        }
     }
-    if (irmpc_options.volume_step > 100) {
+    if (options->volume_step > 100) {
         fprintf (stderr, "ERROR: volume step needs to be in range 0 ... 100\n");
         return false;
     } else {
-        if (irmpc_options.debug) {
-            printf ("volume-step: %d\n", irmpc_options.volume_step);
+        if (options->debug) {
+            printf ("volume-step: %d\n", options->volume_step);
+        }
+    }
+    if ((strcmp (options->input, "lirc") != 0) && (strcmp (options->input, "evdev") != 0) &&
+        (strcmp (options->input, "stdin") != 0) && (strcmp (options->input, "replay") != 0)) {
+        fprintf (stderr, "ERROR: input needs to be one of lirc, evdev, stdin, replay\n");
+        return false;
+    } else if ((strcmp (options->input, "replay") == 0) && (options->trace_replay == NULL)) {
+        fprintf (stderr, "ERROR: no trace file to replay specified\n");
+        return false;
+    } else {
+        if (options->debug) {
+            printf ("input: %s\n", options->input);
+            printf ("input devices: %s\n", options->input_devices);
+            if (options->trace_record != NULL) {
+                printf ("record trace: %s\n", options->trace_record);
+            }
+            if (options->trace_replay != NULL) {
+                printf ("replay trace: %s - speed: %d %%\n", options->trace_replay, options->trace_replay_speed);
+            }
         }
     }
-    if (irmpc_options.lirc_config != NULL) {
-        if (irmpc_options.debug) {
-            printf ("lirc configuration: %s\n", irmpc_options.lirc_config);
+    if (options->lirc_config != NULL) {
+        if (options->debug) {
+            printf ("lirc configuration: %s\n", options->lirc_config);
         }
     }
-    if (irmpc_options.debug) {
-        printf ("lirc keytimespan: %d\n", irmpc_options.lirc_key_timespan);
+    if (options->lirc_key_timespan_ms == 0) {
+        options->lirc_key_timespan_ms = options->lirc_key_timespan * 1000;
+    }
+    if (options->debug) {
+        printf ("lirc keytimespan: %d ms\n", options->lirc_key_timespan_ms);
+        printf ("lirc longpress: %d ms\n", options->lirc_longpress_ms);
+        printf ("lirc skipwindow: %d\n", options->lirc_skip_window);
     }
-    if (irmpc_options.power_command != NULL) {
-        if (irmpc_options.debug) {
-            printf ("poweroff system command: %s\n", irmpc_options.power_command);
+    if (options->power_command != NULL) {
+        if (options->debug) {
+            printf ("poweroff system command: %s\n", options->power_command);
         }
     }
-    if (irmpc_options.debug) {
-        printf ("powerkey repetitions: %d\n", irmpc_options.power_amount);
+    if (options->debug) {
+        printf ("powerkey repetitions: %d\n", options->power_amount);
+        printf ("watch config: %d\n", options->watch_config);
+        if (options->control_socket != NULL) {
+            printf ("control socket: %s\n", options->control_socket);
+        }
     }
 
-    if (irmpc_options.debug) {
-        irmpc_playlist_print_debug ();
+    if (options->debug) {
+        irmpc_playlist_print_debug (table);
     }
 
     return true;
@@ -225,16 +362,22 @@ bool irmpc_parse_options (int *argc, char ***argv)
         goto irmpc_options_exit_error;
     }
 
+    struct irmpc_playlist_table *table = irmpc_playlist_table_new ();
+
     if (irmpc_options.config_file != NULL) {
-        if (!irmpc_options_from_file ()) {
+        if (!irmpc_options_from_file (&(options_initial.options), false, table)) {
+            irmpc_playlist_table_free (table);
             goto irmpc_options_exit_error;
         }
     }
 
-    if (!options_check ()) {
+    if (!options_check (&(options_initial.options), table)) {
+        irmpc_playlist_table_free (table);
         goto irmpc_options_exit_error;
     }
 
+    irmpc_playlist_table_set (table);
+
     g_option_context_free (option_context);
 
     if (error != NULL) {
@@ -251,3 +394,115 @@ irmpc_options_exit_error:
     return false;
 }
 
+
+/* deep copy of options - new snapshot with one reference */
+static struct irmpc_options_snapshot * irmpc_options_copy (const struct _irmpc_options *options)
+{
+    struct irmpc_options_snapshot *snapshot = g_new (struct irmpc_options_snapshot, 1);
+
+    snapshot->options = *options;
+    snapshot->refs    = 1;
+    snapshot->owned   = true;
+
+    for (int i = 0; i < G_N_ELEMENTS (options_strings); i++) {
+        gchar **member = (gchar **) G_STRUCT_MEMBER_P (&(snapshot->options), options_strings[i]);
+        *member = g_strdup (*member);
+    }
+
+    snapshot->options.mpd_rooms      = g_strdupv (options->mpd_rooms);
+    snapshot->options.mpd_room_hosts = g_strdupv (options->mpd_room_hosts);
+
+    return snapshot;
+}
+
+static void irmpc_options_snapshot_free (struct irmpc_options_snapshot *snapshot)
+{
+    for (int i = 0; i < G_N_ELEMENTS (options_strings); i++) {
+        g_free (G_STRUCT_MEMBER (gchar *, &(snapshot->options), options_strings[i]));
+    }
+
+    g_strfreev (snapshot->options.mpd_rooms);
+    g_strfreev (snapshot->options.mpd_room_hosts);
+
+    g_free (snapshot);
+}
+
+/* options of this thread: own snapshot if set, else published one */
+const struct _irmpc_options * irmpc_options_get ()
+{
+    if (options_local != NULL) return &(options_local->options);
+
+    struct irmpc_options_snapshot *current = g_atomic_pointer_get (&options_current);
+
+    return &(current->options);
+}
+
+const struct _irmpc_options * irmpc_options_ref (const struct _irmpc_options *options)
+{
+    struct irmpc_options_snapshot *snapshot = (struct irmpc_options_snapshot *) options;
+
+    if (snapshot->owned) g_atomic_int_inc (&(snapshot->refs));
+
+    return options;
+}
+
+void irmpc_options_unref (const struct _irmpc_options *options)
+{
+    if (options == NULL) return;
+
+    struct irmpc_options_snapshot *snapshot = (struct irmpc_options_snapshot *) options;
+
+    if (snapshot->owned && g_atomic_int_dec_and_test (&(snapshot->refs))) {
+        irmpc_options_snapshot_free (snapshot);
+    }
+}
+
+/* let this thread use given snapshot (NULL: published one)
+ * threads other than main thread need one - published snapshot may be freed on reload */
+void irmpc_options_use (const struct _irmpc_options *options)
+{
+    struct irmpc_options_snapshot *previous = options_local;
+
+    options_local = (options != NULL) ? (struct irmpc_options_snapshot *) irmpc_options_ref (options) : NULL;
+
+    if (previous != NULL) irmpc_options_unref (&(previous->options));
+}
+
+/* replace published snapshot by reloaded options (main thread only)
+ * old snapshot is freed when last thread using it switches */
+void irmpc_options_publish (struct _irmpc_options *options)
+{
+    struct irmpc_options_snapshot *previous = options_current;
+
+    g_atomic_pointer_set (&options_current, (struct irmpc_options_snapshot *) options);
+
+    irmpc_options_unref (&(previous->options));
+}
+
+
+/* read config file again into a copy of current options + new playlist table
+ * nothing is applied - returns NULL if file is invalid */
+struct _irmpc_options * irmpc_options_reload (struct irmpc_playlist_table **table)
+{
+    if (irmpc_options.config_file == NULL) {
+        fprintf (stderr, "WARNING: no config file to reload\n");
+        return NULL;
+    }
+
+    struct _irmpc_options *options = &(irmpc_options_copy (&irmpc_options)->options);
+    *table = irmpc_playlist_table_new ();
+
+    /* derive keytimespan_ms again unless set explicitly */
+    if (options->lirc_key_timespan_ms == options->lirc_key_timespan * 1000) {
+        options->lirc_key_timespan_ms = 0;
+    }
+
+    if ((!irmpc_options_from_file (options, true, *table)) || (!options_check (options, *table))) {
+        irmpc_playlist_table_free (*table);
+        *table = NULL;
+        irmpc_options_unref (options);
+        return NULL;
+    }
+
+    return options;
+}
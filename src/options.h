@@ -10,25 +10,53 @@ struct _irmpc_options {
     const char  *mpd_password;
     unsigned int mpd_port;
     unsigned int mpd_maxtries;
+    unsigned int mpd_keepalive;
     unsigned int mpd_update_amount;
+    unsigned int mpd_partitions;
+    unsigned int mpd_autoplaylists;
+    const char  *mpd_playlist_cache;
+    char       **mpd_rooms;
+    char       **mpd_room_hosts;
 
     unsigned int volume_step;
 
+    const char  *input;
+    const char  *input_devices;
+    const char  *trace_record;
+    const char  *trace_replay;
+    unsigned int trace_replay_speed;
+
     const char  *lirc_config;
     unsigned int lircd_tries;
     unsigned int lirc_key_timespan;
+    unsigned int lirc_key_timespan_ms;
+    unsigned int lirc_longpress_ms;
+    unsigned int lirc_skip_window;
 
     const char  *power_command;
     unsigned int power_amount;
 
+    unsigned int watch_config;
+    const char  *control_socket;
+
     const char  *progname;
 
     bool         verbose;
     bool         debug;
 };
 
-extern struct _irmpc_options irmpc_options;
+/* options are immutable snapshots - reload publishes a new one,
+ * executor threads keep theirs until switched with irmpc_options_use */
+const struct _irmpc_options * irmpc_options_get ();
+#define irmpc_options (*irmpc_options_get ())
+
+struct irmpc_playlist_table;
 
-bool irmpc_parse_options (int *argc, char ***argv);
+bool                          irmpc_parse_options   (int *argc, char ***argv);
+struct _irmpc_options *       irmpc_options_reload  (struct irmpc_playlist_table **table);
+void                          irmpc_options_publish (struct _irmpc_options *options);
+const struct _irmpc_options * irmpc_options_ref     (const struct _irmpc_options *options);
+void                          irmpc_options_unref   (const struct _irmpc_options *options);
+void                          irmpc_options_use     (const struct _irmpc_options *options);
 
 #endif
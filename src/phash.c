@@ -0,0 +1,95 @@
+#include "phash.h"
+
+#include <stdlib.h>
+
+/* seeds tried per table size before doubling it */
+#define IRMPC_PHASH_SEED_TRIES 256
+
+/* splitmix64 finalizer */
+static inline unsigned int irmpc_phash_slot (const struct irmpc_phash *phash, uint64_t key)
+{
+    uint64_t x = key + phash->seed;
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x =  x ^ (x >> 31);
+
+    return (unsigned int) x & phash->mask;
+}
+
+/* find seed + table size mapping all keys to distinct slots
+ * keys need to be unique - returns false otherwise */
+bool irmpc_phash_build (struct irmpc_phash *phash, const uint64_t *keys, unsigned int count)
+{
+    unsigned int size = 4;
+    while (size < 2 * count) size *= 2;
+
+    phash->keys  = NULL;
+    phash->index = NULL;
+
+    for (; size <= 64 * (count + 1); size *= 2) {
+        uint64_t *new_keys  = realloc (phash->keys,  size * sizeof (uint64_t));
+        if (new_keys == NULL) break;
+        phash->keys = new_keys;
+
+        int *new_index = realloc (phash->index, size * sizeof (int));
+        if (new_index == NULL) break;
+        phash->index = new_index;
+
+        phash->mask = size - 1;
+
+        for (phash->seed = 1; phash->seed <= IRMPC_PHASH_SEED_TRIES; phash->seed++) {
+            bool collision = false;
+
+            for (unsigned int s = 0; s < size; s++) phash->index[s] = -1;
+
+            for (unsigned int i = 0; i < count; i++) {
+                unsigned int slot = irmpc_phash_slot (phash, keys[i]);
+                if (phash->index[slot] != -1) {
+                    collision = true;
+                    break;
+                }
+                phash->keys[slot]  = keys[i];
+                phash->index[slot] = i;
+            }
+
+            if (!collision) return true;
+        }
+    }
+
+    irmpc_phash_free (phash);
+    return false;
+}
+
+/* index of key as passed to build - -1 if not contained */
+int irmpc_phash_lookup (const struct irmpc_phash *phash, uint64_t key)
+{
+    if (phash->index == NULL) return -1;
+
+    unsigned int slot = irmpc_phash_slot (phash, key);
+
+    if ((phash->index[slot] == -1) || (phash->keys[slot] != key)) return -1;
+
+    return phash->index[slot];
+}
+
+void irmpc_phash_free (struct irmpc_phash *phash)
+{
+    free (phash->keys);
+    free (phash->index);
+    phash->keys  = NULL;
+    phash->index = NULL;
+}
+
+/* 64 bit FNV-1a of string - key for string sets */
+uint64_t irmpc_phash_string (const char *string)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,22 @@
+#ifndef __phash_h__
+#define __phash_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* perfect hash over a fixed set of 64 bit keys:
+ * every key maps to its own slot, lookups need one hash + one compare */
+struct irmpc_phash {
+    uint64_t     seed;
+    unsigned int mask;
+    uint64_t    *keys;
+    int         *index;
+};
+
+bool irmpc_phash_build  (struct irmpc_phash *phash, const uint64_t *keys, unsigned int count);
+int  irmpc_phash_lookup (const struct irmpc_phash *phash, uint64_t key);
+void irmpc_phash_free   (struct irmpc_phash *phash);
+
+uint64_t irmpc_phash_string (const char *string);
+
+#endif
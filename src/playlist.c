@@ -5,142 +5,354 @@
 #include <string.h>
 #include <glib.h>
 
-/* sorted playlist table (number -> playlist info) */
-static GTree        *playlist_table        = NULL;
-/* memory allocation for playlist names */
+/* playlist table entry */
+struct irmpc_playlist_entry {
+    unsigned int         number;
+    struct playlist_info info;
+};
+
+/* digit trie node over decimal playlist numbers */
+struct irmpc_playlist_trie_node {
+    unsigned int                children [10];   /* node index - 0: none (root is no child) */
+    const struct playlist_info *playlist;        /* playlist with number ending here */
+};
+
+struct irmpc_playlist_table {
+    /* entries sorted by number (sorted lazily after adding) */
+    GArray     *entries;
+    bool        sorted;
+    /* playlist name -> index of first entry with that name */
+    GHashTable *names;
+    /* digit trie (array of nodes, root at 0) - NULL: rebuild on next lookup */
+    GArray     *trie;
+};
+
+/* table used for lookups - one per thread, each mpd executor has its own copy */
+static __thread struct irmpc_playlist_table *playlist_table = NULL;
+
+/* memory allocation for playlist names - shared by all tables,
+ * so names stay valid when a reloaded table replaces the current one */
 static GStringChunk *playlist_name_storage = NULL;
+static GMutex        playlist_name_mutex;
 
-/* compare function for playlist keys (number) */
-static gint irmpc_playlist_table_cmp_func (gconstpointer a, gconstpointer b)
+/* create empty table */
+struct irmpc_playlist_table * irmpc_playlist_table_new ()
 {
-    unsigned int aval = GPOINTER_TO_INT(a);
-    unsigned int bval = GPOINTER_TO_INT(b);
+    struct irmpc_playlist_table *table = g_new0 (struct irmpc_playlist_table, 1);
 
-    if (aval > bval) return  1;
-    if (aval < bval) return -1;
-    return 0;
+    table->entries = g_array_new (false, false, sizeof (struct irmpc_playlist_entry));
+    table->sorted  = true;
+
+    return table;
+}
+
+/* drop name index + trie after changes */
+static void irmpc_playlist_table_invalidate (struct irmpc_playlist_table *table)
+{
+    if (table->names != NULL) {
+        g_hash_table_destroy (table->names);
+        table->names = NULL;
+    }
+
+    if (table->trie != NULL) {
+        g_array_free (table->trie, true);
+        table->trie = NULL;
+    }
+}
+
+/* copy of table (NULL: current one) - names are shared */
+struct irmpc_playlist_table * irmpc_playlist_table_copy (const struct irmpc_playlist_table *table)
+{
+    struct irmpc_playlist_table *copy = irmpc_playlist_table_new ();
+
+    if (table == NULL) table = playlist_table;
+    if (table == NULL) return copy;
+
+    g_array_append_vals (copy->entries, table->entries->data, table->entries->len);
+    copy->sorted = table->sorted;
+
+    return copy;
+}
+
+void irmpc_playlist_table_free (struct irmpc_playlist_table *table)
+{
+    if (table == NULL) return;
+
+    irmpc_playlist_table_invalidate (table);
+    g_array_free (table->entries, true);
+    g_free (table);
 }
 
 /* add a new playlist entry into the table (number, name and random/not random) */
-void irmpc_playlist_add (unsigned int number, const char *name, bool random)
+void irmpc_playlist_table_add (struct irmpc_playlist_table *table, unsigned int number, const char *name, bool random)
 {
     if (name == NULL) return;
 
+    g_mutex_lock (&playlist_name_mutex);
     if (playlist_name_storage == NULL) {
         playlist_name_storage = g_string_chunk_new (64);
-        if (playlist_name_storage == NULL) return;
+    }
+    const char *entry_name = g_string_chunk_insert_const (playlist_name_storage, name);
+    g_mutex_unlock (&playlist_name_mutex);
+
+    struct irmpc_playlist_entry entry = {
+        .number = number,
+        .info   = {
+            .name   = entry_name,
+            .random = random
+        }
+    };
+
+    /* keep table sorted as long as numbers come in ascending order */
+    if (table->entries->len > 0) {
+        unsigned int last = g_array_index (table->entries, struct irmpc_playlist_entry, table->entries->len - 1).number;
+        if (number <= last) table->sorted = false;
     }
 
-    gchar *entry_name = g_string_chunk_insert (playlist_name_storage, name);
+    g_array_append_val (table->entries, entry);
 
+    irmpc_playlist_table_invalidate (table);
+}
+
+/* use table for lookups from now on - frees the previous one */
+void irmpc_playlist_table_set (struct irmpc_playlist_table *table)
+{
+    irmpc_playlist_table_free (playlist_table);
+    playlist_table = table;
+}
+
+/* add a new playlist entry into the current table */
+void irmpc_playlist_add (unsigned int number, const char *name, bool random)
+{
     if (playlist_table == NULL) {
-        playlist_table = g_tree_new (irmpc_playlist_table_cmp_func);
-        if (playlist_table == NULL) return;
+        playlist_table = irmpc_playlist_table_new ();
     }
 
-    struct playlist_info *entry;
+    irmpc_playlist_table_add (playlist_table, number, name, random);
+}
+
+/* compare function for playlist entries (number) */
+static gint irmpc_playlist_entry_cmp_func (gconstpointer a, gconstpointer b)
+{
+    unsigned int aval = ((const struct irmpc_playlist_entry *) a)->number;
+    unsigned int bval = ((const struct irmpc_playlist_entry *) b)->number;
+
+    if (aval > bval) return  1;
+    if (aval < bval) return -1;
+    return 0;
+}
+
+/* sort table after adding + build name index - later entries replace earlier ones with same number */
+static void irmpc_playlist_index (struct irmpc_playlist_table *table)
+{
+    GArray *entries = table->entries;
 
-    entry = (struct playlist_info *) malloc (sizeof (struct playlist_info));
-    if (entry == NULL) return;
+    if (!table->sorted) {
+        /* stable sort keeps order of equal numbers */
+        g_array_sort (entries, irmpc_playlist_entry_cmp_func);
+
+        unsigned int out = 0;
+        for (unsigned int i = 0; i < entries->len; i++) {
+            struct irmpc_playlist_entry *entry = &g_array_index (entries, struct irmpc_playlist_entry, i);
+
+            if ((out > 0) && (g_array_index (entries, struct irmpc_playlist_entry, out - 1).number == entry->number)) {
+                out--;
+            }
+            g_array_index (entries, struct irmpc_playlist_entry, out) = *entry;
+            out++;
+        }
+        g_array_set_size (entries, out);
+
+        table->sorted = true;
+    }
+
+    if (table->names == NULL) {
+        table->names = g_hash_table_new (g_str_hash, g_str_equal);
+
+        for (unsigned int i = 0; i < entries->len; i++) {
+            const char *name = g_array_index (entries, struct irmpc_playlist_entry, i).info.name;
+
+            if (!g_hash_table_contains (table->names, name)) {
+                g_hash_table_insert (table->names, (gpointer) name, GUINT_TO_POINTER (i));
+            }
+        }
+    }
+}
+
+/* current table if it has entries - indexed */
+static struct irmpc_playlist_table * irmpc_playlist_current ()
+{
+    if ((playlist_table == NULL) || (playlist_table->entries->len == 0)) return NULL;
 
-    entry->name   = entry_name;
-    entry->random = random;
+    irmpc_playlist_index (playlist_table);
 
-    g_tree_insert (playlist_table, GINT_TO_POINTER(number), entry);
+    return playlist_table;
+}
+
+/* index of playlist with given number in sorted table - -1 if none */
+static int irmpc_playlist_find (struct irmpc_playlist_table *table, unsigned int number)
+{
+    /* binary search */
+    unsigned int low  = 0;
+    unsigned int high = table->entries->len;
+
+    while (low < high) {
+        unsigned int mid        = low + (high - low) / 2;
+        unsigned int number_mid = g_array_index (table->entries, struct irmpc_playlist_entry, mid).number;
+
+        if (number_mid == number) return mid;
+
+        if (number_mid < number) {
+            low  = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return -1;
 }
 
 /* get playlist info of given number if available */
 const struct playlist_info * irmpc_playlist_get (unsigned int number)
 {
-    if (playlist_table == NULL) return NULL;
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return NULL;
 
-    gpointer result = g_tree_lookup (playlist_table, GINT_TO_POINTER (number));
+    int index = irmpc_playlist_find (table, number);
+    if (index < 0) return NULL;
 
-    return (struct playlist_info *) result;
+    return &(g_array_index (table->entries, struct irmpc_playlist_entry, index).info);
 }
 
-/* user data for next/prev playlist lookup traversal */
-struct irmpc_nextprev_playlist_traverse_data {
-    int direction;
-    const struct playlist_info *prev;
-    const struct playlist_info *result;
-    const char *lookup_name;
-};
+/* number of (first) playlist with given name */
+bool irmpc_playlist_number (const char *name, unsigned int *number)
+{
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return false;
+
+    gpointer value;
+    if (!g_hash_table_lookup_extended (table->names, name, NULL, &value)) return false;
+
+    *number = g_array_index (table->entries, struct irmpc_playlist_entry, GPOINTER_TO_UINT (value)).number;
+
+    return true;
+}
 
-/* traversal function for next/prev playlist traversal */
-static gboolean irmpc_nextprev_playlist_traverse (gpointer key, gpointer value, gpointer data)
+/* remove playlist entry - name stays in string storage */
+bool irmpc_playlist_remove (unsigned int number)
 {
-    struct playlist_info *entry                         = (struct playlist_info *) value;
-    struct irmpc_nextprev_playlist_traverse_data *tdata = (struct irmpc_nextprev_playlist_traverse_data *) data;
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return false;
 
-    if (tdata->direction >= 0) {
-        /* search next */
-        if (tdata->lookup_name == NULL) {
-            /* no current playlist - use first one */
-            tdata->result = entry;
-            return true;
-        }
-        if (tdata->prev == NULL) {
-            /* first entry: set result in case lookup_name matches none or last */
-            tdata->result = entry;
-        } else {
-            /* check if previous entry matches lookup name */
-            if (strcmp (tdata->prev->name, tdata->lookup_name) == 0) {
-                tdata->result = entry;
-                return true;
-            }
-        }
-    } else {
-        /* search prev */
-        /* set result in case of last entry and no match */
-        tdata->result = entry;
-
-        /* first entry: on match use last entry anyway */
-        if (tdata->prev != NULL) {
-            /* check if current matches */
-            if (tdata->lookup_name != NULL) {
-                if (strcmp (entry->name, tdata->lookup_name) == 0) {
-                    tdata->result = tdata->prev;
-                    return true;
-                }
-            }
+    int index = irmpc_playlist_find (table, number);
+    if (index < 0) return false;
 
-        }
-    }
+    g_array_remove_index (table->entries, index);
+    irmpc_playlist_table_invalidate (table);
 
-    tdata->prev   = entry;
+    return true;
+}
+
+/* number following the highest playlist number */
+unsigned int irmpc_playlist_next_free ()
+{
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return 1;
 
-    return false;
+    return g_array_index (table->entries, struct irmpc_playlist_entry, table->entries->len - 1).number + 1;
 }
 
-/* search next/prev playlist */
+/* search next/prev playlist - wrapping around at the ends
+ * without (known) lookup name next is the first and prev the last playlist */
 const struct playlist_info * irmpc_playlist_nextprev (int direction, const char *lookup_name)
 {
-    struct irmpc_nextprev_playlist_traverse_data tdata = {direction, NULL, NULL, lookup_name};
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return NULL;
 
-    g_tree_foreach (playlist_table, irmpc_nextprev_playlist_traverse, (gpointer) (&tdata));
+    unsigned int len = table->entries->len;
+    unsigned int index;
+    gpointer     value;
 
-    return tdata.result;
+    if ((lookup_name != NULL) && g_hash_table_lookup_extended (table->names, lookup_name, NULL, &value)) {
+        index = GPOINTER_TO_UINT (value);
+        index = (direction >= 0) ? ((index + 1) % len) : ((index + len - 1) % len);
+    } else {
+        index = (direction >= 0) ? 0 : (len - 1);
+    }
+
+    return &(g_array_index (table->entries, struct irmpc_playlist_entry, index).info);
 }
 
+/* insert playlist number into digit trie */
+static void irmpc_playlist_trie_insert (GArray *trie, unsigned int number, const struct playlist_info *playlist)
+{
+    char digits [16];
+    snprintf (digits, sizeof (digits), "%u", number);
+
+    unsigned int node = 0;
+
+    for (const char *d = digits; *d != '\0'; d++) {
+        unsigned int digit = *d - '0';
+        unsigned int child = g_array_index (trie, struct irmpc_playlist_trie_node, node).children[digit];
+
+        if (child == 0) {
+            struct irmpc_playlist_trie_node new_node = {{0}, NULL};
+
+            child = trie->len;
+            g_array_append_val (trie, new_node);
+            g_array_index (trie, struct irmpc_playlist_trie_node, node).children[digit] = child;
+        }
+
+        node = child;
+    }
 
+    g_array_index (trie, struct irmpc_playlist_trie_node, node).playlist = playlist;
+}
 
-/* traversal function for freeing playlist table entries */
-static gboolean irmpc_playlist_entry_free (gpointer key, gpointer value, gpointer data)
+/* look up entered digits in playlist numbers */
+enum irmpc_playlist_match irmpc_playlist_match (const char *digits, const struct playlist_info **playlist)
 {
-    if (value == NULL) return false;
-    free (value);
-    return false;
+    *playlist = NULL;
+
+    struct irmpc_playlist_table *table = irmpc_playlist_current ();
+    if (table == NULL) return IRMPC_PLAYLIST_MATCH_NONE;
+
+    if (table->trie == NULL) {
+        struct irmpc_playlist_trie_node root = {{0}, NULL};
+
+        table->trie = g_array_new (false, false, sizeof (struct irmpc_playlist_trie_node));
+        g_array_append_val (table->trie, root);
+
+        for (unsigned int i = 0; i < table->entries->len; i++) {
+            struct irmpc_playlist_entry *entry = &g_array_index (table->entries, struct irmpc_playlist_entry, i);
+            irmpc_playlist_trie_insert (table->trie, entry->number, &(entry->info));
+        }
+    }
+
+    unsigned int node = 0;
+
+    for (const char *d = digits; *d != '\0'; d++) {
+        if ((*d < '0') || (*d > '9')) return IRMPC_PLAYLIST_MATCH_NONE;
+
+        node = g_array_index (table->trie, struct irmpc_playlist_trie_node, node).children[*d - '0'];
+        if (node == 0) return IRMPC_PLAYLIST_MATCH_NONE;
+    }
+
+    const struct irmpc_playlist_trie_node *entry = &g_array_index (table->trie, struct irmpc_playlist_trie_node, node);
+
+    *playlist = entry->playlist;
+
+    for (int digit = 0; digit < 10; digit++) {
+        if (entry->children[digit] != 0) return IRMPC_PLAYLIST_MATCH_PREFIX;
+    }
+
+    return IRMPC_PLAYLIST_MATCH_UNIQUE;
 }
 
 /* free playlist info (table + strings) */
 void irmpc_playlist_free ()
 {
-    if (playlist_table != NULL) {
-        g_tree_foreach (playlist_table, irmpc_playlist_entry_free, NULL);
-        g_tree_destroy (playlist_table);
-        playlist_table = NULL;
-    }
+    irmpc_playlist_table_set (NULL);
 
     if (playlist_name_storage != NULL) {
         g_string_chunk_free (playlist_name_storage);
@@ -148,25 +360,19 @@ void irmpc_playlist_free ()
     }
 }
 
-/* traversal function for printing of playlist table */
-static gboolean irmpc_playlist_entry_print_debug (gpointer key, gpointer value, gpointer data)
+/* print playlist table - used for debugging */
+void irmpc_playlist_print_debug (struct irmpc_playlist_table *table)
 {
-    unsigned int number = GPOINTER_TO_INT(key);
-    struct playlist_info *entry = (struct playlist_info *) value;
-
-    if (entry == NULL) return false;
+    if (table == NULL) table = playlist_table;
 
-    fprintf (stderr, " %04d -> \"%s\"%s\n", number, entry->name, (entry->random ? "  (random)" : ""));
-
-    return false;
-}
+    if ((table != NULL) && (table->entries->len > 0)) {
+        irmpc_playlist_index (table);
 
-/* print playlist table - used for debugging */
-void irmpc_playlist_print_debug ()
-{
-    if (playlist_table != NULL) {
         fprintf (stderr, "playlist:\n");
-        g_tree_foreach (playlist_table, irmpc_playlist_entry_print_debug, NULL);
+        for (unsigned int i = 0; i < table->entries->len; i++) {
+            struct irmpc_playlist_entry *entry = &g_array_index (table->entries, struct irmpc_playlist_entry, i);
+            fprintf (stderr, " %04d -> \"%s\"%s\n", entry->number, entry->info.name, (entry->info.random ? "  (random)" : ""));
+        }
     } else {
         fprintf (stderr, "playlist empty\n");
     }
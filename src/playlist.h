@@ -8,11 +8,33 @@ struct playlist_info {
     bool        random;
 };
 
+/* result of looking up entered digits */
+enum irmpc_playlist_match {
+    IRMPC_PLAYLIST_MATCH_NONE,     /* no playlist number starts with digits */
+    IRMPC_PLAYLIST_MATCH_PREFIX,   /* longer numbers possible - playlist set if digits match one */
+    IRMPC_PLAYLIST_MATCH_UNIQUE    /* digits match playlist, no longer number possible */
+};
+
+/* playlist table - one is current per thread, others can be filled and swapped in */
+struct irmpc_playlist_table;
+
+struct irmpc_playlist_table * irmpc_playlist_table_new  ();
+void                          irmpc_playlist_table_add  (struct irmpc_playlist_table *table, unsigned int number, const char *name, bool random);
+void                          irmpc_playlist_table_set  (struct irmpc_playlist_table *table);
+struct irmpc_playlist_table * irmpc_playlist_table_copy (const struct irmpc_playlist_table *table);
+void                          irmpc_playlist_table_free (struct irmpc_playlist_table *table);
+
+/* current table */
 void                         irmpc_playlist_add      (unsigned int number, const char *name, bool random);
 const struct playlist_info * irmpc_playlist_get      (unsigned int number);
 const struct playlist_info * irmpc_playlist_nextprev (int direction, const char *lookup_name);
+enum irmpc_playlist_match    irmpc_playlist_match    (const char *digits, const struct playlist_info **playlist);
+
+bool                         irmpc_playlist_number    (const char *name, unsigned int *number);
+bool                         irmpc_playlist_remove    (unsigned int number);
+unsigned int                 irmpc_playlist_next_free ();
 
 void irmpc_playlist_free ();
-void irmpc_playlist_print_debug ();
+void irmpc_playlist_print_debug (struct irmpc_playlist_table *table);
 
 #endif
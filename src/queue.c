@@ -0,0 +1,100 @@
+#include "queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/* number of entries - must be a power of two */
+#define IRMPC_QUEUE_SIZE 64
+#define IRMPC_QUEUE_MASK (IRMPC_QUEUE_SIZE - 1)
+
+/* single producer / single consumer ring buffer:
+ * tail is only written by the producer, head only by the consumer,
+ * both are free running and masked on access */
+struct irmpc_queue {
+    unsigned int         tail __attribute__ ((aligned (64)));
+    unsigned int         head __attribute__ ((aligned (64)));
+    int                  wakeup_fd;
+    struct irmpc_command entries [IRMPC_QUEUE_SIZE];
+};
+
+/* create empty queue with wakeup eventfd */
+struct irmpc_queue * irmpc_queue_new ()
+{
+    struct irmpc_queue *queue = NULL;
+
+    if (posix_memalign ((void **) &queue, 64, sizeof (struct irmpc_queue)) != 0) return NULL;
+
+    memset (queue, 0, sizeof (struct irmpc_queue));
+
+    queue->wakeup_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->wakeup_fd == -1) {
+        free (queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+/* free queue and close wakeup fd */
+void irmpc_queue_free (struct irmpc_queue *queue)
+{
+    if (queue == NULL) return;
+
+    close (queue->wakeup_fd);
+    free (queue);
+}
+
+/* append command - returns false if queue is full */
+bool irmpc_queue_push (struct irmpc_queue *queue, const struct irmpc_command *command)
+{
+    unsigned int tail = __atomic_load_n (&(queue->tail), __ATOMIC_RELAXED);
+    unsigned int head = __atomic_load_n (&(queue->head), __ATOMIC_ACQUIRE);
+
+    if (tail - head >= IRMPC_QUEUE_SIZE) return false;
+
+    queue->entries[tail & IRMPC_QUEUE_MASK] = *command;
+
+    __atomic_store_n (&(queue->tail), tail + 1, __ATOMIC_RELEASE);
+
+    uint64_t one = 1;
+    if (write (queue->wakeup_fd, &one, sizeof (one)) != sizeof (one)) {
+        /* counter saturated - consumer is woken up anyway */
+    }
+
+    return true;
+}
+
+/* fd becoming readable when commands were pushed */
+int irmpc_queue_fd (const struct irmpc_queue *queue)
+{
+    return queue->wakeup_fd;
+}
+
+/* reset wakeup fd - call before draining the queue */
+void irmpc_queue_clear_wakeup (struct irmpc_queue *queue)
+{
+    uint64_t count;
+    if (read (queue->wakeup_fd, &count, sizeof (count)) != sizeof (count)) {
+        /* nothing pending */
+    }
+}
+
+/* remove next command - returns false if queue is empty */
+bool irmpc_queue_pop (struct irmpc_queue *queue, struct irmpc_command *command)
+{
+    unsigned int head = __atomic_load_n (&(queue->head), __ATOMIC_RELAXED);
+    unsigned int tail = __atomic_load_n (&(queue->tail), __ATOMIC_ACQUIRE);
+
+    if (head == tail) return false;
+
+    if (command != NULL) {
+        *command = queue->entries[head & IRMPC_QUEUE_MASK];
+    }
+
+    __atomic_store_n (&(queue->head), head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
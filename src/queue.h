@@ -0,0 +1,21 @@
+#ifndef __queue_h__
+#define __queue_h__
+
+#include "command.h"
+
+#include <stdbool.h>
+
+struct irmpc_queue;
+
+struct irmpc_queue * irmpc_queue_new    ();
+void                 irmpc_queue_free   (struct irmpc_queue *queue);
+
+/* producer side */
+bool                 irmpc_queue_push   (struct irmpc_queue *queue, const struct irmpc_command *command);
+
+/* consumer side */
+int                  irmpc_queue_fd     (const struct irmpc_queue *queue);
+void                 irmpc_queue_clear_wakeup (struct irmpc_queue *queue);
+bool                 irmpc_queue_pop    (struct irmpc_queue *queue, struct irmpc_command *command);
+
+#endif
@@ -0,0 +1,194 @@
+#include "reload.h"
+#include "options.h"
+#include "playlist.h"
+#include "irhandler.h"
+#include "mpd.h"
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* time to wait for further file events before reloading */
+#define IRMPC_RELOAD_DELAY_MS 200
+
+static guint reload_signal_id  = 0;
+static int   reload_inotify_fd = -1;
+static guint reload_watch_id   = 0;
+static guint reload_timeout_id = 0;
+
+static bool irmpc_reload_strv_equal (char **a, char **b)
+{
+    if ((a == NULL) || (b == NULL)) return (a == b);
+
+    for (; (*a != NULL) && (*b != NULL); a++, b++) {
+        if (strcmp (*a, *b) != 0) return false;
+    }
+
+    return ((*a == NULL) && (*b == NULL));
+}
+
+/* settings only used on startup - changing them needs a restart */
+static void irmpc_reload_check_fixed (const struct _irmpc_options *old, const struct _irmpc_options *new)
+{
+    const char *changed [8];
+    int         count = 0;
+
+    if (g_strcmp0 (old->input,          new->input)          != 0) changed[count++] = "input";
+    if (g_strcmp0 (old->input_devices,  new->input_devices)  != 0) changed[count++] = "inputdevices";
+    if (g_strcmp0 (old->trace_record,   new->trace_record)   != 0) changed[count++] = "record";
+    if (g_strcmp0 (old->trace_replay,   new->trace_replay)   != 0) changed[count++] = "replay";
+    if (old->trace_replay_speed != new->trace_replay_speed)        changed[count++] = "replayspeed";
+    if (old->watch_config       != new->watch_config)              changed[count++] = "watchconfig";
+    if (g_strcmp0 (old->control_socket, new->control_socket) != 0) changed[count++] = "controlsocket";
+    if ((!irmpc_reload_strv_equal (old->mpd_rooms,      new->mpd_rooms)) ||
+        (!irmpc_reload_strv_equal (old->mpd_room_hosts, new->mpd_room_hosts))) {
+        changed[count++] = "rooms";
+    }
+
+    for (int i = 0; i < count; i++) {
+        fprintf (stderr, "WARNING: changed setting %s is not applied before restart\n", changed[i]);
+    }
+}
+
+/* read config file + lirc config again and apply them if both are valid
+ * mpd connection and state are kept */
+void irmpc_reload ()
+{
+    struct irmpc_playlist_table *table = NULL;
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: reloading configuration\n");
+    }
+
+    struct _irmpc_options *options = irmpc_options_reload (&table);
+    if (options == NULL) {
+        fprintf (stderr, "ERROR: reloading config file failed - keeping current configuration\n");
+        return;
+    }
+
+    if (!irmpc_irhandler_reload (options->lirc_config)) {
+        fprintf (stderr, "ERROR: reloading lirc config failed - keeping current configuration\n");
+        irmpc_playlist_table_free (table);
+        irmpc_options_unref (options);
+        return;
+    }
+
+    irmpc_reload_check_fixed (&irmpc_options, options);
+
+    /* executor threads switch to published options with their playlist table */
+    irmpc_options_publish (options);
+    irmpc_mpd_reload (table);
+}
+
+static gboolean irmpc_reload_signal (gpointer data)
+{
+    irmpc_reload ();
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean irmpc_reload_timeout (gpointer data)
+{
+    reload_timeout_id = 0;
+    irmpc_reload ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* file event: reload once events stop for a moment (editors write in several steps) */
+static gboolean irmpc_reload_inotify (gint fd, GIOCondition condition, gpointer data)
+{
+    char buffer [4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    bool relevant = false;
+
+    ssize_t len;
+    while ((len = read (fd, buffer, sizeof (buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *) ptr;
+
+            if (event->len > 0) {
+                gchar *config_base = (irmpc_options.config_file != NULL) ? g_path_get_basename (irmpc_options.config_file) : NULL;
+                gchar *lirc_base   = (irmpc_options.lirc_config != NULL) ? g_path_get_basename (irmpc_options.lirc_config) : NULL;
+
+                if (((config_base != NULL) && (strcmp (event->name, config_base) == 0)) ||
+                    ((lirc_base   != NULL) && (strcmp (event->name, lirc_base)   == 0))) {
+                    relevant = true;
+                }
+
+                g_free (config_base);
+                g_free (lirc_base);
+            }
+
+            ptr += sizeof (struct inotify_event) + event->len;
+        }
+    }
+
+    if (relevant) {
+        if (reload_timeout_id != 0) g_source_remove (reload_timeout_id);
+        reload_timeout_id = g_timeout_add (IRMPC_RELOAD_DELAY_MS, irmpc_reload_timeout, NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* watch directory of file - files are often replaced instead of written */
+static void irmpc_reload_watch (const char *file)
+{
+    if (file == NULL) return;
+
+    gchar *dir = g_path_get_dirname (file);
+
+    if (inotify_add_watch (reload_inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        fprintf (stderr, "WARNING: failed to watch %s for config changes\n", dir);
+    }
+
+    g_free (dir);
+}
+
+/* reload on SIGHUP and if enabled on config file changes */
+bool irmpc_reload_init ()
+{
+    reload_signal_id = g_unix_signal_add (SIGHUP, irmpc_reload_signal, NULL);
+
+    if (!irmpc_options.watch_config) return true;
+
+    reload_inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (reload_inotify_fd == -1) {
+        fprintf (stderr, "ERROR: failed to initialize inotify\n");
+        return false;
+    }
+
+    irmpc_reload_watch (irmpc_options.config_file);
+    irmpc_reload_watch (irmpc_options.lirc_config);
+
+    reload_watch_id = g_unix_fd_add (reload_inotify_fd, G_IO_IN, irmpc_reload_inotify, NULL);
+
+    return true;
+}
+
+void irmpc_reload_free ()
+{
+    if (reload_signal_id != 0) {
+        g_source_remove (reload_signal_id);
+        reload_signal_id = 0;
+    }
+
+    if (reload_timeout_id != 0) {
+        g_source_remove (reload_timeout_id);
+        reload_timeout_id = 0;
+    }
+
+    if (reload_watch_id != 0) {
+        g_source_remove (reload_watch_id);
+        reload_watch_id = 0;
+    }
+
+    if (reload_inotify_fd != -1) {
+        close (reload_inotify_fd);
+        reload_inotify_fd = -1;
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef __reload_h__
+#define __reload_h__
+
+#include <stdbool.h>
+
+bool irmpc_reload_init ();
+void irmpc_reload      ();
+void irmpc_reload_free ();
+
+#endif
@@ -0,0 +1,265 @@
+#include "schedule.h"
+
+#include <stdlib.h>
+
+/* commands kept per class - oldest one is dropped when full */
+#define IRMPC_SCHEDULE_BACKLOG 16
+
+/* age in us after which a command is dropped instead of run (0: never) */
+static const int64_t irmpc_schedule_deadline [IRMPC_SCHEDULE_CLASSES] = {
+    [IRMPC_SCHEDULE_URGENT] = 0,
+    [IRMPC_SCHEDULE_NORMAL] = 10 * 1000000,
+    [IRMPC_SCHEDULE_BULK]   =  2 * 1000000
+};
+
+/* fifo per class - sequence: order of adding across classes */
+struct irmpc_schedule_class {
+    unsigned int         head;
+    unsigned int         count;
+    struct irmpc_command commands [IRMPC_SCHEDULE_BACKLOG];
+    uint64_t             sequence [IRMPC_SCHEDULE_BACKLOG];
+};
+
+struct irmpc_schedule {
+    irmpc_schedule_drop_callback dropped;
+    struct irmpc_schedule_class  classes [IRMPC_SCHEDULE_CLASSES];
+    uint64_t                     sequence;
+};
+
+struct irmpc_schedule * irmpc_schedule_new (irmpc_schedule_drop_callback dropped)
+{
+    struct irmpc_schedule *schedule = calloc (1, sizeof (struct irmpc_schedule));
+    if (schedule == NULL) return NULL;
+
+    schedule->dropped = dropped;
+
+    return schedule;
+}
+
+void irmpc_schedule_free (struct irmpc_schedule *schedule)
+{
+    free (schedule);
+}
+
+/* class of command */
+enum irmpc_schedule_priority irmpc_schedule_priority (const struct irmpc_command *command)
+{
+    switch (command->op) {
+        case IRMPC_OP_STOP:
+        case IRMPC_OP_PLAYPAUSE:
+        case IRMPC_OP_PLAY:
+        case IRMPC_OP_PAUSE:
+            return IRMPC_SCHEDULE_URGENT;
+        case IRMPC_OP_NEXT:
+        case IRMPC_OP_PREV:
+        case IRMPC_OP_NEXTALBUM:
+        case IRMPC_OP_PREVALBUM:
+        case IRMPC_OP_ALBUMSTART:
+        case IRMPC_OP_ALBUMSKIP:
+        case IRMPC_OP_VOLUME_UP:
+        case IRMPC_OP_VOLUME_DOWN:
+        case IRMPC_OP_VOLUME_MUTE:
+            return IRMPC_SCHEDULE_BULK;
+        default:
+            return IRMPC_SCHEDULE_NORMAL;
+    }
+}
+
+/* command changes what is played (player state, position, queue) - no later non urgent command may overtake it,
+ * else the result would depend on the class and not on the order of key presses */
+static bool irmpc_schedule_barrier (const struct irmpc_command *command)
+{
+    switch (command->op) {
+        case IRMPC_OP_PLAYPAUSE:
+        case IRMPC_OP_PLAY:
+        case IRMPC_OP_PAUSE:
+        case IRMPC_OP_STOP:
+        case IRMPC_OP_NEXT:
+        case IRMPC_OP_PREV:
+        case IRMPC_OP_DELETE:
+        case IRMPC_OP_PLAYLISTUPDATE:
+        case IRMPC_OP_NEXTPLAYLIST:
+        case IRMPC_OP_PREVPLAYLIST:
+        case IRMPC_OP_NEXTALBUM:
+        case IRMPC_OP_PREVALBUM:
+        case IRMPC_OP_ALBUMSTART:
+        case IRMPC_OP_ALBUMSKIP:
+        case IRMPC_OP_PLAYLIST_KEY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* command moves playback elsewhere - obsolete once a later stop/pause arrives */
+static bool irmpc_schedule_navigation (const struct irmpc_command *command)
+{
+    switch (command->op) {
+        case IRMPC_OP_NEXT:
+        case IRMPC_OP_PREV:
+        case IRMPC_OP_NEXTPLAYLIST:
+        case IRMPC_OP_PREVPLAYLIST:
+        case IRMPC_OP_NEXTALBUM:
+        case IRMPC_OP_PREVALBUM:
+        case IRMPC_OP_ALBUMSTART:
+        case IRMPC_OP_ALBUMSKIP:
+        case IRMPC_OP_PLAYLIST_KEY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* command silences playback - waiting navigation would only start it again */
+static bool irmpc_schedule_supersedes (const struct irmpc_command *command)
+{
+    return ((command->op == IRMPC_OP_STOP) || (command->op == IRMPC_OP_PAUSE));
+}
+
+/* remove oldest command of class */
+static void irmpc_schedule_class_drop (struct irmpc_schedule *schedule, struct irmpc_schedule_class *class, const char *reason)
+{
+    const struct irmpc_command *command = &(class->commands[class->head]);
+
+    class->head = (class->head + 1) % IRMPC_SCHEDULE_BACKLOG;
+    class->count--;
+
+    if (schedule->dropped != NULL) {
+        schedule->dropped (command, reason);
+    }
+}
+
+/* remove all navigation commands of class - order of the others is kept */
+static void irmpc_schedule_class_supersede (struct irmpc_schedule *schedule, struct irmpc_schedule_class *class)
+{
+    unsigned int kept = 0;
+
+    for (unsigned int c = 0; c < class->count; c++) {
+        unsigned int slot = (class->head + c) % IRMPC_SCHEDULE_BACKLOG;
+
+        if (irmpc_schedule_navigation (&(class->commands[slot]))) {
+            if (schedule->dropped != NULL) {
+                schedule->dropped (&(class->commands[slot]), "superseded");
+            }
+            continue;
+        }
+
+        unsigned int to = (class->head + kept) % IRMPC_SCHEDULE_BACKLOG;
+        if (to != slot) {
+            class->commands[to] = class->commands[slot];
+            class->sequence[to] = class->sequence[slot];
+        }
+        kept++;
+    }
+
+    class->count = kept;
+}
+
+/* queue command in its class - stop/pause drop all waiting navigation */
+void irmpc_schedule_add (struct irmpc_schedule *schedule, const struct irmpc_command *command)
+{
+    struct irmpc_schedule_class *class = &(schedule->classes[irmpc_schedule_priority (command)]);
+
+    if (irmpc_schedule_supersedes (command)) {
+        for (int i = IRMPC_SCHEDULE_URGENT + 1; i < IRMPC_SCHEDULE_CLASSES; i++) {
+            irmpc_schedule_class_supersede (schedule, &(schedule->classes[i]));
+        }
+    }
+
+    if (class->count >= IRMPC_SCHEDULE_BACKLOG) {
+        irmpc_schedule_class_drop (schedule, class, "backlog full");
+    }
+
+    unsigned int slot = (class->head + class->count) % IRMPC_SCHEDULE_BACKLOG;
+
+    class->commands[slot] = *command;
+    class->sequence[slot] = schedule->sequence++;
+    class->count++;
+}
+
+/* whether an older command of a lower class than given one must run first */
+static bool irmpc_schedule_blocked (const struct irmpc_schedule *schedule, int priority, uint64_t sequence)
+{
+    for (int i = priority + 1; i < IRMPC_SCHEDULE_CLASSES; i++) {
+        const struct irmpc_schedule_class *class = &(schedule->classes[i]);
+
+        for (unsigned int c = 0; c < class->count; c++) {
+            unsigned int slot = (class->head + c) % IRMPC_SCHEDULE_BACKLOG;
+
+            /* fifo: rest of class is younger */
+            if (class->sequence[slot] > sequence) break;
+            if (irmpc_schedule_barrier (&(class->commands[slot]))) return true;
+        }
+    }
+
+    return false;
+}
+
+/* next command to run - dropping stale ones on the way
+ * urgent commands always run first, other classes preempt lower ones unless an older state changing
+ * command is waiting there: then commands run in order of adding */
+const struct irmpc_command * irmpc_schedule_peek (struct irmpc_schedule *schedule, int64_t now)
+{
+    int first  = -1;
+    int oldest = -1;
+
+    for (int i = 0; i < IRMPC_SCHEDULE_CLASSES; i++) {
+        struct irmpc_schedule_class *class = &(schedule->classes[i]);
+
+        while (class->count > 0) {
+            const struct irmpc_command *command = &(class->commands[class->head]);
+
+            if ((irmpc_schedule_deadline[i] == 0) || (now - command->time <= irmpc_schedule_deadline[i])) {
+                break;
+            }
+
+            irmpc_schedule_class_drop (schedule, class, "stale");
+        }
+
+        if (class->count == 0) continue;
+
+        if (first == -1) first = i;
+        if ((oldest == -1) || (class->sequence[class->head] < schedule->classes[oldest].sequence[schedule->classes[oldest].head])) {
+            oldest = i;
+        }
+    }
+
+    if (first == -1) return NULL;
+
+    struct irmpc_schedule_class *class = &(schedule->classes[first]);
+    if ((first != IRMPC_SCHEDULE_URGENT) && irmpc_schedule_blocked (schedule, first, class->sequence[class->head])) {
+        class = &(schedule->classes[oldest]);
+    }
+
+    return &(class->commands[class->head]);
+}
+
+/* take next command to run - returns false if none left */
+bool irmpc_schedule_pop (struct irmpc_schedule *schedule, int64_t now, struct irmpc_command *command)
+{
+    const struct irmpc_command *next = irmpc_schedule_peek (schedule, now);
+    if (next == NULL) return false;
+
+    struct irmpc_schedule_class *class = &(schedule->classes[irmpc_schedule_priority (next)]);
+
+    if (command != NULL) {
+        *command = *next;
+    }
+
+    class->head = (class->head + 1) % IRMPC_SCHEDULE_BACKLOG;
+    class->count--;
+
+    return true;
+}
+
+/* number of commands waiting */
+unsigned int irmpc_schedule_length (const struct irmpc_schedule *schedule)
+{
+    unsigned int length = 0;
+
+    for (int i = 0; i < IRMPC_SCHEDULE_CLASSES; i++) {
+        length += schedule->classes[i].count;
+    }
+
+    return length;
+}
@@ -0,0 +1,33 @@
+#ifndef __schedule_h__
+#define __schedule_h__
+
+#include "command.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* command classes - lower value preempts higher one, but only urgent ones overtake an older state changing command */
+enum irmpc_schedule_priority {
+    IRMPC_SCHEDULE_URGENT,   /* stop, pause - never dropped for age */
+    IRMPC_SCHEDULE_NORMAL,   /* playlists, modes, queue editing     */
+    IRMPC_SCHEDULE_BULK,     /* volume + navigation                 */
+    IRMPC_SCHEDULE_CLASSES
+};
+
+/* called for each command dropped from schedule - reason: "stale", "backlog full" or "superseded" (by stop/pause) */
+typedef void (*irmpc_schedule_drop_callback) (const struct irmpc_command *command, const char *reason);
+
+struct irmpc_schedule;
+
+struct irmpc_schedule * irmpc_schedule_new  (irmpc_schedule_drop_callback dropped);
+void                    irmpc_schedule_free (struct irmpc_schedule *schedule);
+
+enum irmpc_schedule_priority irmpc_schedule_priority (const struct irmpc_command *command);
+
+void                         irmpc_schedule_add    (struct irmpc_schedule *schedule, const struct irmpc_command *command);
+/* now: monotonic time in us as stamped into commands */
+const struct irmpc_command * irmpc_schedule_peek   (struct irmpc_schedule *schedule, int64_t now);
+bool                         irmpc_schedule_pop    (struct irmpc_schedule *schedule, int64_t now, struct irmpc_command *command);
+unsigned int                 irmpc_schedule_length (const struct irmpc_schedule *schedule);
+
+#endif
@@ -0,0 +1,296 @@
+#include "trace.h"
+#include "options.h"
+#include "irhandler.h"
+
+#include <glib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* trace file: magic, then per command
+ *   varint  time in us since previous command (since start of recording for first one)
+ *   varint  lirc repeat counter
+ *   byte    length of config string
+ *   bytes   config string like "m:next" */
+#define IRMPC_TRACE_MAGIC     "IRMPCTR1"
+#define IRMPC_TRACE_MAGIC_LEN 8
+/* longest varint of 64 bit value */
+#define IRMPC_TRACE_VARINT_MAX 10
+
+/* command read from trace - time relative to start */
+struct irmpc_trace_entry {
+    gint64       time;
+    unsigned int repeat;
+    char         string [IRMPC_COMMAND_ARG_MAX + 2];
+};
+
+/* recording */
+static FILE   *trace_file = NULL;
+static gint64  trace_last = 0;
+
+/* replay: entries + next one due, speed in percent (0: as fast as possible) */
+static GArray                    *replay_entries   = NULL;
+static guint                      replay_next      = 0;
+static unsigned int               replay_speed     = 100;
+static gint64                     replay_start     = 0;
+static guint                      replay_source_id = 0;
+static irmpc_trace_done_callback  replay_done      = NULL;
+/* statistics: commands dropped by mpd queue, delay behind trace timing */
+static unsigned int               replay_dropped   = 0;
+static gint64                     replay_lag_max   = 0;
+static gint64                     replay_lag_sum   = 0;
+
+static gsize irmpc_trace_varint_put (guchar *buffer, guint64 value)
+{
+    gsize len = 0;
+
+    while (value >= 0x80) {
+        buffer[len++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buffer[len++] = value;
+
+    return len;
+}
+
+/* returns false if data ends within value */
+static bool irmpc_trace_varint_get (const guchar **data, const guchar *end, guint64 *value)
+{
+    *value = 0;
+
+    for (unsigned int shift = 0; (*data < end) && (shift < 7 * IRMPC_TRACE_VARINT_MAX); shift += 7) {
+        guchar byte = *((*data)++);
+        *value |= ((guint64) (byte & 0x7f)) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+/* start writing trace file */
+bool irmpc_trace_record_init (const char *path)
+{
+    trace_file = fopen (path, "wb");
+    if (trace_file == NULL) {
+        fprintf (stderr, "ERROR: failed to open trace file %s: %s\n", path, strerror (errno));
+        return false;
+    }
+
+    if (fwrite (IRMPC_TRACE_MAGIC, 1, IRMPC_TRACE_MAGIC_LEN, trace_file) != IRMPC_TRACE_MAGIC_LEN) {
+        fprintf (stderr, "ERROR: failed to write trace file %s: %s\n", path, strerror (errno));
+        fclose (trace_file);
+        trace_file = NULL;
+        return false;
+    }
+
+    trace_last = g_get_monotonic_time ();
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: recording commands to %s\n", path);
+    }
+
+    return true;
+}
+
+/* append decoded command - flushed right away to survive crashes */
+void irmpc_trace_record (const struct irmpc_command *command)
+{
+    if (trace_file == NULL) return;
+
+    guchar buffer [2 * IRMPC_TRACE_VARINT_MAX + 1 + sizeof (struct irmpc_trace_entry)];
+    gint64 now = g_get_monotonic_time ();
+    gsize  len = 0;
+    size_t arg = strlen (command->arg);
+
+    len += irmpc_trace_varint_put (&(buffer[len]), now - trace_last);
+    len += irmpc_trace_varint_put (&(buffer[len]), command->repeat);
+    buffer[len++] = arg + 2;
+    buffer[len++] = "mvps"[command->type];
+    buffer[len++] = ':';
+    memcpy (&(buffer[len]), command->arg, arg);
+    len += arg;
+
+    trace_last = now;
+
+    if ((fwrite (buffer, 1, len, trace_file) != len) || (fflush (trace_file) != 0)) {
+        fprintf (stderr, "ERROR: failed to write trace file: %s - recording stopped\n", strerror (errno));
+        fclose (trace_file);
+        trace_file = NULL;
+    }
+}
+
+/* read all entries of trace file - a truncated last entry is dropped */
+static GArray * irmpc_trace_read (const char *path)
+{
+    gchar  *contents = NULL;
+    gsize   length   = 0;
+    GError *error    = NULL;
+
+    if (!g_file_get_contents (path, &contents, &length, &error)) {
+        fprintf (stderr, "ERROR: failed to load trace file %s: %s\n", path, error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    if ((length < IRMPC_TRACE_MAGIC_LEN) || (memcmp (contents, IRMPC_TRACE_MAGIC, IRMPC_TRACE_MAGIC_LEN) != 0)) {
+        fprintf (stderr, "ERROR: %s is no irmpc trace file\n", path);
+        g_free (contents);
+        return NULL;
+    }
+
+    GArray       *entries = g_array_new (false, true, sizeof (struct irmpc_trace_entry));
+    const guchar *data    = (const guchar *) contents + IRMPC_TRACE_MAGIC_LEN;
+    const guchar *end     = (const guchar *) contents + length;
+    gint64        time    = 0;
+
+    while (data < end) {
+        struct irmpc_trace_entry entry;
+        guint64                  delta;
+        guint64                  repeat;
+
+        if ((!irmpc_trace_varint_get (&data, end, &delta)) || (!irmpc_trace_varint_get (&data, end, &repeat)) ||
+            (data >= end) || (*data >= sizeof (entry.string)) || (data + 1 + *data > end)) {
+            fprintf (stderr, "WARNING: trace file %s truncated after %u commands\n", path, entries->len);
+            break;
+        }
+
+        time         += delta;
+        entry.time    = time;
+        entry.repeat  = repeat;
+        memcpy (entry.string, data + 1, *data);
+        entry.string[*data] = '\0';
+        data         += 1 + *data;
+
+        g_array_append_val (entries, entry);
+    }
+
+    g_free (contents);
+
+    return entries;
+}
+
+/* time entry is due - now if replaying as fast as possible */
+static gint64 irmpc_trace_replay_due (const struct irmpc_trace_entry *entry)
+{
+    if (replay_speed == 0) return g_get_monotonic_time ();
+
+    return replay_start + entry->time * 100 / replay_speed;
+}
+
+static void irmpc_trace_replay_entry (const struct irmpc_trace_entry *entry, gint64 due)
+{
+    gint64 lag = g_get_monotonic_time () - due;
+
+    replay_lag_sum += lag;
+    if (lag > replay_lag_max) replay_lag_max = lag;
+
+    if (irmpc_options.debug) {
+        printf ("Replayed command: \"%s\" - repeat: %u\n", entry->string, entry->repeat);
+    }
+
+    struct irmpc_command command;
+    if (!irmpc_command_compile (entry->string, &command)) {
+        fprintf (stderr, "WARNING: ignoring command \"%s\" in trace - unknown\n", entry->string);
+        return;
+    }
+
+    command.repeat = entry->repeat;
+    if (!irmpc_irhandler_command (&command)) {
+        replay_dropped++;
+    }
+}
+
+static gboolean irmpc_trace_replay_step (gpointer data);
+
+/* wait for next entry - report + notify when done */
+static void irmpc_trace_replay_schedule ()
+{
+    if (replay_next >= replay_entries->len) {
+        gint64 duration = g_get_monotonic_time () - replay_start;
+        gint64 original = (replay_entries->len > 0) ? g_array_index (replay_entries, struct irmpc_trace_entry, replay_entries->len - 1).time : 0;
+
+        printf ("INFO: replayed %u commands in %lld ms (recorded: %lld ms) - dropped: %u, lag max: %lld us, mean: %lld us\n",
+                replay_entries->len, (long long) (duration / 1000), (long long) (original / 1000), replay_dropped,
+                (long long) replay_lag_max, (long long) (replay_lag_sum / MAX (replay_entries->len, 1)));
+
+        if (replay_done != NULL) {
+            replay_done ();
+        }
+        return;
+    }
+
+    /* as fast as possible: one command per main loop iteration - inputs stay responsive */
+    if (replay_speed == 0) {
+        replay_source_id = g_idle_add (irmpc_trace_replay_step, NULL);
+        return;
+    }
+
+    gint64 wait = irmpc_trace_replay_due (&g_array_index (replay_entries, struct irmpc_trace_entry, replay_next)) - g_get_monotonic_time ();
+    if (wait < 0) wait = 0;
+
+    replay_source_id = g_timeout_add ((wait + 999) / 1000, irmpc_trace_replay_step, NULL);
+}
+
+/* dispatch all entries due */
+static gboolean irmpc_trace_replay_step (gpointer data)
+{
+    replay_source_id = 0;
+
+    while (replay_next < replay_entries->len) {
+        const struct irmpc_trace_entry *entry = &g_array_index (replay_entries, struct irmpc_trace_entry, replay_next);
+        gint64                          due   = irmpc_trace_replay_due (entry);
+
+        if (due > g_get_monotonic_time ()) break;
+
+        irmpc_trace_replay_entry (entry, due);
+        replay_next++;
+
+        if (replay_speed == 0) break;
+    }
+
+    irmpc_trace_replay_schedule ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* feed commands of trace file to dispatcher from main loop
+ * speed in percent of recorded timing - 0: as fast as possible */
+bool irmpc_trace_replay_init (const char *path, unsigned int speed, irmpc_trace_done_callback done)
+{
+    replay_entries = irmpc_trace_read (path);
+    if (replay_entries == NULL) return false;
+
+    replay_speed = speed;
+    replay_done  = done;
+    replay_next  = 0;
+    replay_start = g_get_monotonic_time ();
+
+    if (irmpc_options.verbose) {
+        printf ("INFO: replaying %u commands from %s\n", replay_entries->len, path);
+    }
+
+    /* first step from main loop - done callback may quit it */
+    replay_source_id = g_idle_add (irmpc_trace_replay_step, NULL);
+
+    return true;
+}
+
+void irmpc_trace_free ()
+{
+    if (trace_file != NULL) {
+        fclose (trace_file);
+        trace_file = NULL;
+    }
+
+    if (replay_source_id != 0) {
+        g_source_remove (replay_source_id);
+        replay_source_id = 0;
+    }
+
+    if (replay_entries != NULL) {
+        g_array_free (replay_entries, true);
+        replay_entries = NULL;
+    }
+
+    replay_done = NULL;
+}
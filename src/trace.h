@@ -0,0 +1,16 @@
+#ifndef __trace_h__
+#define __trace_h__
+
+#include "command.h"
+
+#include <stdbool.h>
+
+/* called when all commands of trace are replayed */
+typedef void (*irmpc_trace_done_callback) ();
+
+bool irmpc_trace_record_init (const char *path);
+void irmpc_trace_record      (const struct irmpc_command *command);
+bool irmpc_trace_replay_init (const char *path, unsigned int speed, irmpc_trace_done_callback done);
+void irmpc_trace_free        ();
+
+#endif